@@ -7,10 +7,36 @@
 //the power increasing by a given increment. This data will then be written to a JSON file.
 
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <limits.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "GeneralizedMandelbrot.h"
 
 //Constants for the user to change
 //Scale factor of the window
@@ -19,6 +45,178 @@ const int SCALE = 300;
 const float START = -10, END = 10;
 //The number of frames
 const int DIVISIONS = 100000;
+//Set to 1 to write every frame into one indexed archive file instead of the JSON files
+const int ARCHIVE = 0;
+const char *ARCHIVE_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/files/mandelbrot_nums.gmba";
+//Set to 1 to run a local tile server for browsing the sets instead of doing a sweep
+const int TILE_SERVER = 0;
+const int TILE_PORT = 8080;
+const int TILE_SIZE = 256;
+const int TILE_THREADS = 4;
+//Rendered tiles are kept in memory until they take up more than this many bytes
+const size_t TILE_CACHE_BYTES = 512 * 1024 * 1024;
+//Set to 1 to render a single preview frame of PREVIEW_POWER, giving up on refining it after PREVIEW_SECONDS
+const int PREVIEW = 0;
+const float PREVIEW_POWER = 2;
+const double PREVIEW_SECONDS = 0.5;
+//Pixels between samples in the first (coarsest) pass of a preview, should be a power of 2
+const int PREVIEW_STEP = 8;
+//Set to 1 to antialias the sweeps. Only pixels whose escape count differs from a neighbor's get
+//supersampled, each one with AA_GRID by AA_GRID samples.
+const int ANTIALIAS = 0;
+const int AA_GRID = 4;
+//Most extra samples to spend on one frame, the pixels with the biggest jumps get them first
+const int AA_BUDGET = 2000000;
+//Set to 1 to run the sweep as a pipeline (compute -> color -> encode -> write) so the disk
+//writes overlap with the math. Each stage gets its own threads, the write stage always has one
+//so the frames come out in order.
+//The thread counts here and in the other modes are replaced by the machine's TUNE profile if it has one.
+const int PIPELINE = 0;
+int COMPUTE_THREADS = 6;
+int COLOR_THREADS = 1;
+int ENCODE_THREADS = 2;
+//Most frames that can be somewhere in the pipeline at once, this caps the memory used
+int FRAMES_IN_FLIGHT = 12;
+//Set to 1 to have the pipeline render every COARSE_STEP-th frame first, then the ones halfway between
+//those, and so on down to every frame, so a low frame rate version of the whole video shows up early.
+//The archive has a place for every frame from the start and fills them in as they come (readers see
+//the finished ones, ArchiveFrame() returns NULL for the rest). JSON frames are kept in .part files
+//until everything for their file is done, then the file is written in order.
+const int COARSE_TO_FINE = 0;
+//Has to be a power of 2
+const int COARSE_STEP = 1024;
+//Set to 1 to pin the compute threads to NUMA nodes and keep each frame's buffers on the node that renders it
+const int NUMA = 1;
+//Set to 1 to back frame buffers with huge pages where the OS has them
+const int HUGE_PAGES = 1;
+//Set to 1 to check the candidate kernel against the reference one instead of doing a sweep.
+//The run fails if any frame of the corpus goes over one of the tolerances. With CERTIFY set the certified
+//kernel gets checked too, at every frame of a CERTIFY_BLOCK frame block from each corpus power on.
+//With BAILOUT set it checks that both escape radii give the same set instead.
+const int ACCURACY = 0;
+//Pixels across each corpus frame
+const int ACCURACY_SIZE = 300;
+//Most pixels (as a fraction of the frame) whose escape count can differ
+const float ACCURACY_MAX_MISMATCH = 0.001;
+//Most any one pixel's escape count can be off by
+const float ACCURACY_MAX_ESCAPE_DIFF = 1;
+//Most any one pixel's color can be off by, out of 255 (in vs out of the set counts as 255)
+const float ACCURACY_MAX_HUE_ERROR = 4;
+//Set to 1 to render one huge frame of POSTER_POWER tile by tile into a tiled BigTIFF. Only one
+//tile per thread is ever in memory, the escape counts wait on disk in POSTER_COUNTS_PATH between passes.
+const int POSTER = 0;
+const float POSTER_POWER = 2;
+const long POSTER_WIDTH = 65536, POSTER_HEIGHT = 65536;
+const int POSTER_TILE = 512;
+int POSTER_THREADS = 8;
+const char *POSTER_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/imgs/poster.tif";
+const char *POSTER_COUNTS_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/files/poster_counts.raw";
+//Set to 1 to keep every frame's escape counts on disk, so sweeps that overlap an old one only render the new frames.
+//Frames are looked up by a hash of everything that goes into them, the least recently used go once the cache is over FRAME_CACHE_BYTES.
+const int FRAME_CACHE = 0;
+const char *FRAME_CACHE_DIR = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/cache";
+const long long FRAME_CACHE_BYTES = 50LL * 1024 * 1024 * 1024;
+//Set to 1 to animate the view along ZOOM_PATH (zooming, panning and changing the power between
+//keyframes) instead of sweeping the power. Frames go to the archive if ARCHIVE is set, otherwise to the JSON files.
+const int ZOOM = 0;
+const int ZOOM_FRAMES = 2000;
+//A pixel reuses last frame's escape count if the point it was computed at is at most this many pixels away.
+//That isn't exact: a test zoom had 173 of about 3.2 million counts come out different from rendering every frame
+//from scratch (points right by a boundary whose neighbors all agreed). 0 only reuses counts from exactly the same point.
+const float ZOOM_TOLERANCE = 0.5;
+//Set to 1 to run the power sweep (one low priority job per JSON file) and serve tiles like TILE_SERVER
+//at the same time. Tile requests jump ahead of the sweep between columns, so the viewer stays responsive.
+//It writes JSON files only (no ARCHIVE). SHM and DZI get the frames as the workers finish them, so not in order.
+const int SCHEDULER = 0;
+int SCHEDULER_THREADS = 4;
+//Set to 1 to also publish every frame of the JSON, archive, pipeline or scheduled sweep (or the zoom) as a Deep Zoom
+//pyramid for web viewers (OpenSeadragon etc.), frame_000000.dzi and so on, numbered by frame. Tiles that
+//look the same as in the frame before are hard links to its files instead of being written again.
+const int DZI = 0;
+const char *DZI_DIR = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/dzi";
+const int DZI_TILE = 256;
+int DZI_THREADS = 4;
+//Set to 1 to give each frame its own iteration budget, between ADAPTIVE_MIN_I and MAX_I. A quick probe
+//of every ADAPTIVE_STEP-th pixel finds how many iterations the frame's escaping points actually need,
+//so frames that escape fast (most negative and fractional powers) stop wasting iterations on the inside.
+//Frames that need more than MAX_I get a warning, raise MAX_I for those.
+const int ADAPTIVE = 0;
+const int ADAPTIVE_MIN_I = 16;
+const int ADAPTIVE_STEP = 8;
+//At most this fraction of the probe's escaping pixels may take longer than the budget (and show up as inside)
+const float ADAPTIVE_QUALITY = 0.001;
+//Set to 1 to keep, for every frame, the escape counts plus where each point that never escaped stopped.
+//Rendering the same frame again with a bigger MAX_I then only iterates those points, from where they
+//stopped, instead of starting the whole frame over. (Not used for frames ADAPTIVE renders.)
+const int CONTINUE = 0;
+const char *CONTINUE_DIR = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/orbits";
+//Set to 1 to work out, once for every CERTIFY_BLOCK frames in a row, which pixels escape after the same number
+//of iterations for every power in the block (see MandelbrotCertify()). Those pixels are copied into each frame
+//of the block, only the rest get iterated per frame. Pays off when frames of a block are rendered close together
+//in time (not with COARSE_TO_FINE). (Not used for frames ADAPTIVE or CONTINUE render.)
+const int CERTIFY = 0;
+const int CERTIFY_BLOCK = 16;
+//Set to 1 to render a contact sheet of small frames over a grid of powers and offsets (cR, cI) instead of
+//the sweep. Each column of the sheet is a power, each row an offset (cR changes fastest). ATLAS_PATH gets
+//the sheet, ATLAS_STATS_PATH one CSV line of statistics per cell.
+const int ATLAS = 0;
+const float ATLAS_POWER_START = -4, ATLAS_POWER_END = 6;
+const int ATLAS_POWERS = 21;
+//cR and cI both go from ATLAS_C_MIN to ATLAS_C_MAX in ATLAS_C_STEPS steps
+const float ATLAS_C_MIN = -1, ATLAS_C_MAX = 1;
+const int ATLAS_C_STEPS = 9;
+const int ATLAS_CELL = 64;
+int ATLAS_THREADS = 8;
+const char *ATLAS_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/imgs/atlas.png";
+const char *ATLAS_STATS_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/files/atlas.csv";
+//Set to 1 to benchmark this machine on a few frames of the sweep and save the best thread counts to a
+//profile in TUNE_DIR named after the CPU. Every run after that (on a machine with the same CPU) loads it
+//at startup, so each machine in the farm uses its own settings without anyone editing the ones above.
+const int TUNE = 0;
+const char *TUNE_DIR = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/tuning";
+//The benchmark frames are this many times smaller across than the real ones
+const int TUNE_SHRINK = 6;
+//Set to 1 to only work out statistics for each frame of the sweep (area inside the set, escape count
+//histogram, mean escape count, boundary length) instead of rendering it. STATS_PATH gets a header and one
+//small record per frame, see struct StatsHeader. No frame is ever kept in memory, only two columns of one.
+const int STATS = 0;
+const char *STATS_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/files/mandelbrot_stats.gmbs";
+int STATS_THREADS = 8;
+//Set to 1 to also publish every frame of the sweep into shared memory (SHM_NAME, which is /dev/shm/mandelbrot_frames
+//on Linux), so a viewer or encoder can map it and show frames as they come with no files in between. The last
+//SHM_SLOTS frames are kept and a slow reader skips frames rather than holding the sweep up, see struct ShmHeader.
+//SHM_RAW = 1 publishes the escape counts instead of the colors.
+const int SHM = 0;
+const char *SHM_NAME = "/mandelbrot_frames";
+const int SHM_SLOTS = 8;
+const int SHM_RAW = 0;
+//Set to 1 to estimate what the sweep will cost instead of running it. ESTIMATE_SAMPLES frames spread over the
+//powers are rendered ESTIMATE_SHRINK times smaller across and timed, and that gives a cost for every frame
+//(see EstimateSweep()). Prints the CPU-hours, the wall time on ESTIMATE_CORES cores and how big the output
+//will be, and splits the frames into ESTIMATE_SHARDS shards that should all take about as long, saved to SHARD_PATH.
+const int ESTIMATE = 0;
+const int ESTIMATE_SAMPLES = 200;
+const int ESTIMATE_SHRINK = 10;
+const int ESTIMATE_CORES = 16;
+const int ESTIMATE_SHARDS = 8;
+//Set to a shard number from SHARD_PATH to have the pipeline only render that shard's frames, -1 renders them all.
+//Shards start and end on JSON file boundaries, so each one writes whole files.
+const int SHARD = -1;
+const char *SHARD_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/files/shards.txt";
+//Set to 1 to work out where the DIVISIONS + 1 frames should go instead of spacing them INCREMENT apart.
+//SPACING_SAMPLES powers get rendered SPACING_SHRINK times smaller across, and frames are packed in where the
+//escape counts change the most between them. SPACING_FLOOR (times the average change) keeps some frames in the
+//parts that barely move. The powers go to SPACING_PATH with a time for each one (0 to 1), showing frame k at
+//time k of the video makes the set change at the same speed all the way through.
+//With USE_SPACING = 1 every sweep takes its powers from there, except the original JSON one, which stops with an
+//error instead of quietly ignoring it (use PIPELINE for JSON files).
+const int ADAPTIVE_SPACING = 0;
+const int USE_SPACING = 0;
+const int SPACING_SAMPLES = 20000;
+const int SPACING_SHRINK = 10;
+const float SPACING_FLOOR = 0.1;
+int SPACING_THREADS = 8;
+const char *SPACING_PATH = "/Users/Sean/Documents/Coding/Eclipse/Visualize Mandelbrot from C/files/spacing.txt";
 
 //Constants the user should NOT change
 const int WIDTH = 3*SCALE, HEIGHT = 3*SCALE;
@@ -31,14 +229,315 @@ const float MAX_Y = CENTER_Y + RANGE_Y/2.0;
 const float INCREMENT = (float)(END - START) / DIVISIONS;
 const float PERFILE = 100.0;
 const int MAX_I = 80;
+//Set to 1 to stop iterating a point once |z| passes its power's own escape radius, max(|c|, 2^(1/(power-1)))
+//for power > 1 (see MandelbrotBailout()), instead of 4. Saves iterations from power 1.5 up but changes the escape
+//counts and so the colors. ACCURACY then checks that it doesn't change which points are in the set (a few points
+//that only just escape get seen before MAX_I instead of after it). Not with CERTIFY.
+//(TUNE, ESTIMATE and ADAPTIVE_SPACING still time and measure frames with radius 4.)
+const int BAILOUT = 0;
 
 struct Complex{
   float re;
   float im;
 };
 
+//Bump this whenever a change to the kernel changes the escape counts, so old cached frames stop matching
+#define KERNEL_VERSION 2
+
+#define STATS_MAGIC 0x53424d47
+#define STATS_VERSION 1
+
+//Writer side, frames get appended to the end of the file. The reader side is in the library.
+struct Archive{
+  FILE *fp;
+  struct ArchiveHeader header;
+  uint64_t end;
+};
+
+//Bounded lock free queue of slot numbers, one cell per slot. Each cell's sequence number
+//says whether it is ready to be pushed to or popped from for the current lap.
+struct RingCell{
+  atomic_size_t sequence;
+  int value;
+};
+
+struct Ring{
+  struct RingCell *cells;
+  size_t mask;
+  atomic_size_t head;
+  atomic_size_t tail;
+};
+
+//Everything one frame needs on its way through the pipeline
+struct PipelineSlot{
+  int frame;
+  //Place in the order frames are rendered in, same as frame unless COARSE_TO_FINE is on
+  int position;
+  float power;
+  //NUMA node the slot's memory lives on, it only ever goes to compute threads on that node
+  int node;
+  int touched;
+  float *values;
+  float *histogram;
+  float *nums;
+  char *text;
+  size_t textLength;
+};
+
+//Times are summed over all the threads in the stage. Starved is time spent waiting for
+//work from the stage before, blocked is time spent waiting for room in the next one.
+struct Stage{
+  const char *name;
+  int threads;
+  atomic_int alive;
+  struct Ring *in;
+  struct Ring *out;
+  pthread_mutex_t lock;
+  double busy, starved, blocked;
+};
+
+//CPUs that share a memory controller
+struct NumaNode{
+  int *cpus;
+  int count;
+};
+
+//Renders a size by size view centered on (centerX, centerY), range wide, into values
+//(same layout as Mandelbrot()). Anything that can do that can be checked by AccuracyCheck().
+typedef void (*FrameKernel)(float *values, int size, float centerX, float centerY, float range, float power, float cR, float cI, int maxI);
+
+//One frame of the accuracy corpus
+struct AccuracyCase{
+  float power;
+  float centerX, centerY;
+  float range;
+};
+
+//Shared by the poster threads. Pass 1 renders tiles into the counts file and adds them to
+//the global histogram, pass 2 colors them from it and writes them into the TIFF.
+struct Poster{
+  int countsFd, tiffFd;
+  long tilesX, tilesY;
+  atomic_long nextTile;
+  int pass;
+  pthread_mutex_t lock;
+  uint64_t *histogram;
+  float *hues;
+  uint64_t dataStart;
+};
+
+//Everything that decides what a frame's escape counts come out as. A frame is cached under
+//a hash of this, and the key is stored in the file too so a hash collision can't return the wrong frame.
+struct FrameKey{
+  uint32_t version;
+  float power, cR, cI;
+  float minX, maxX, minY, maxY;
+  int32_t width, height, maxI;
+  int32_t aaGrid, aaBudget;
+  int32_t adaptiveMinI, adaptiveStep;
+  float adaptiveQuality;
+  int32_t bailout;
+};
+
+//One cell of the atlas
+struct AtlasCell{
+  float power, cR, cI;
+  //Fraction of pixels inside the set, and of pixels next to one with another escape count
+  float inside, boundary;
+  float meanEscape;
+  int maxEscape;
+};
+
+//Shared by the atlas threads. Every cell is the same window, so the pixel coordinates are worked out once.
+struct Atlas{
+  struct AtlasCell *cells;
+  int count;
+  atomic_int next;
+  float *re, *im;
+  unsigned char *sheet;
+  int sheetWidth;
+};
+
+//The statistics file is this header, then count records back to back. Each record is a StatsRecord
+//followed by its histogram, maxI uint32_t counts of the pixels that escaped after 0 to maxI - 1 iterations.
+//Record k is for frame k, at sizeof(struct StatsHeader) + k * (sizeof(struct StatsRecord) + maxI * 4).
+struct StatsHeader{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t maxI;
+  uint32_t count;
+  float minX, maxX, minY, maxY;
+};
+
+struct StatsRecord{
+  float power;
+  //Pixels that never escaped, and the area of the plane they cover
+  uint32_t inside;
+  float area;
+  //Mean escape count of the pixels that did escape
+  float meanEscape;
+  //Length of the edges between inside and escaped pixels, in the same units as the plane
+  float boundary;
+};
+
+//Shared by the statistics threads
+struct Stats{
+  int fd;
+  atomic_int next;
+};
+
+//Escape counts every frame of a block shares, -1 for the pixels that have to be iterated per frame.
+//Threads that need a block's certificate all work on it a column at a time until it is done.
+struct Certificate{
+  int block;
+  float cR, cI;
+  int users;
+  uint64_t lastUse;
+  int16_t *counts;
+  atomic_int nextColumn;
+  atomic_int doneColumns;
+  atomic_int certified;
+};
+
+//Where a point that hadn't escaped yet stopped, index is the pixel (i * HEIGHT + j)
+struct OrbitState{
+  int32_t index;
+  float zRe, zIm;
+};
+
+//A point on the zoom path. time goes from 0 (first frame) to 1 (last frame),
+//range is the width of the window (the height follows from WIDTH and HEIGHT).
+struct Keyframe{
+  double time;
+  double centerX, centerY;
+  double range;
+  float power;
+};
+
+//Zooms into the seahorse valley of the regular set, then turns the power up on the way back out
+const struct Keyframe ZOOM_PATH[] = {
+  {0, 0, 0, 3.5, 2},
+  {0.6, -0.7453, 0.1127, 0.0005, 2},
+  {0.8, -0.7453, 0.1127, 0.0005, 2},
+  {1, 0, 0, 3.5, 3}
+};
+
+//A pixel on the edge of a jump in escape counts, see Antialias()
+struct Boundary{
+  int index;
+  float contrast;
+};
+
+//At zoom level z the window is split into 2^z by 2^z tiles
+struct TileKey{
+  float power;
+  int zoom;
+  int x, y;
+  int maxI;
+};
+
+#define TILE_PENDING 0
+#define TILE_RENDERING 1
+#define TILE_READY 2
+#define TILE_BUCKETS 4096
+
+//A tile is put in the hash table as soon as someone asks for it, so anyone else asking
+//for the same tile while it renders just waits for it instead of rendering it again.
+struct Tile{
+  struct TileKey key;
+  float *data;
+  int state;
+  int waiters;
+  //Set while the scheduler renders it, so it can be cancelled
+  struct Job *job;
+  struct Tile *hashNext;
+  //Pending tiles are kept in the queue, ready ones in the LRU list
+  struct Tile *prev, *next;
+};
+
+struct TileCache{
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t ready;
+  struct Tile *buckets[TILE_BUCKETS];
+  struct Tile *queue;
+  struct Tile *newest, *oldest;
+  size_t bytes;
+  //Tiles inside the viewport get rendered first
+  int hasViewport;
+  float viewPower;
+  int viewZoom, viewX0, viewY0, viewX1, viewY1;
+};
+
+#define TILE_CANCELLED 3
+
+#define JOB_INTERACTIVE 0
+#define JOB_BATCH 1
+#define JOB_CLASSES 2
+
+#define JOB_FRAME 0
+#define JOB_TILE 1
+#define JOB_SWEEP 2
+
+#define JOB_QUEUED 0
+#define JOB_RUNNING 1
+#define JOB_DONE 2
+#define JOB_CANCELLED 3
+
+//A render request handed to the scheduler. The caller keeps it as a future: JobWait() blocks until
+//it is done or cancelled, after which values and histogram hold the frame or tile. Sweeps hand
+//each frame to frameDone as it finishes instead. Call JobRelease() once done with it.
+struct Job{
+  int kind;
+  int priority;
+  float power, cR, cI;
+  struct TileKey tile;
+  int firstFrame, frames;
+  void (*frameDone)(int frame, float *values, float *histogram);
+  float *values, *histogram;
+  atomic_int cancelled;
+  int state;
+  //The caller and the scheduler each hold one
+  int refs;
+  struct Job *next;
+};
+
+struct Scheduler{
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t done;
+  struct Job *head[JOB_CLASSES], *tail[JOB_CLASSES];
+  //Queued jobs per class, read without the lock by JobCheckpoint()
+  atomic_int waiting[JOB_CLASSES];
+  int stopping;
+  int threads;
+  pthread_t *workers;
+};
+
+//Every level of one frame's Deep Zoom pyramid as RGB, level 0 is 1x1 and the last one is full size
+struct Pyramid{
+  int levels;
+  int width[32], height[32];
+  unsigned char *rgb[32];
+};
+
+//One level's worth of work split over DZI_THREADS threads, each index is a row or a tile
+struct DziTask{
+  struct Pyramid *current, *previous;
+  const float *nums;
+  int frame;
+  int level;
+  int count;
+  void (*body)(struct DziTask *task, int index);
+  atomic_int next;
+  atomic_int written, linked;
+};
+
 void Mandelbrot(float *values, float *histogram, float power, float cR, float cI);
 void CalculateColors(float *values, float *histogram, float *arr);
+int Escape(float re, float im, float power, float cR, float cI, int maxI);
 
 float map(float var1, float start1, float end1, float start2, float end2);
 float LinearInterpolation(float num1, float num2, float point);
@@ -50,45 +549,206 @@ void MiddleWriteToJSON(float *arr, int index);
 void LastWriteToJSON(float *arr, int index);
 void FinishWriteToJSON(int index);
 
+void SweepToJSON();
+void SweepToArchive();
+float FramePower(int frame);
+int FrameFile(int frame);
+int FileFirstFrame(int file);
+int FileLastFrame(int file);
+int FrameOrder(int position, int last);
+int CoarseStep(int frame);
+
+int ArchiveOpen(struct Archive *archive, const char *path, int capacity, uint32_t flags);
+int ArchiveAppend(struct Archive *archive, float power, const float *arr, int length);
+int ArchiveClose(struct Archive *archive);
+int ArchiveReserve(struct Archive *archive, int length, float (*power)(int frame), int first);
+int ArchivePut(struct Archive *archive, int frame, float power, const float *arr, int length);
+
+void TileServer();
+void* TileConnection(void *arg);
+void* TileWorker(void *arg);
+float* TileGet(struct TileKey key);
+void RenderTile(struct TileKey key, float *data);
+int TilePriority(const struct TileKey *key);
+void TileEvict();
+void TileCancelStale();
+void TileUnlink(struct Tile *tile);
+float QueryParam(const char *query, const char *name, float fallback);
+int WriteAll(int fd, const void *data, size_t length);
+int WriteText(int fd, const char *text);
+
+void Preview();
+int ProgressiveMandelbrot(float *values, float *histogram, float power, float cR, float cI, double seconds, void (*pass)(float *values, int step));
+double Seconds();
+
+void RenderFrame(float *values, float *histogram, float power, float cR, float cI);
+void ComputeFrame(float *values, float *histogram, float power, float cR, float cI);
+int AdaptiveMandelbrot(float *values, float *histogram, float power, float cR, float cI);
+void ContinueMandelbrot(float *values, float *histogram, float power, float cR, float cI);
+int OrbitLoad(const struct FrameKey *key, float *values, struct OrbitState **states, int *count);
+void OrbitStore(const struct FrameKey *key, const float *values, const struct OrbitState *states, int count);
+void Antialias(float *values, float power, float cR, float cI, int maxI);
+int CompareBoundary(const void *a, const void *b);
+
+void SweepPipeline();
+void* ComputeStage(void *arg);
+void* ColorStage(void *arg);
+void* EncodeStage(void *arg);
+void* WriteStage(void *arg);
+void StageDone(struct Stage *stage, double busy, double starved, double blocked);
+size_t EncodeFrame(const float *arr, char *text);
+void WritePart(const struct PipelineSlot *frame, int *remaining);
+void RingInit(struct Ring *ring, int capacity);
+void RingFree(struct Ring *ring);
+int RingPush(struct Ring *ring, int value);
+int RingPop(struct Ring *ring, int *value);
+double RingPushWait(struct Ring *ring, int value);
+double RingPopWait(struct Ring *ring, int *value);
+
+int NumaTopology(struct NumaNode **nodes);
+void NumaFree(struct NumaNode *nodes, int count);
+void PinThread(const struct NumaNode *node);
+void* FrameAlloc(size_t bytes);
+void FrameFree(void *buffer, size_t bytes);
+
+int AccuracyCheck(FrameKernel reference, FrameKernel candidate, int frames);
+int BailoutCheck();
+void ReferenceKernel(float *values, int size, float centerX, float centerY, float range, float power, float cR, float cI, int maxI);
+void EscapeKernel(float *values, int size, float centerX, float centerY, float range, float power, float cR, float cI, int maxI);
+void CertifiedKernel(float *values, int size, float centerX, float centerY, float range, float power, float cR, float cI, int maxI);
+int EscapeReference(float re, float im, float power, float cR, float cI, int maxI);
+void Hues(const float *histogram, float *hues, int maxI);
+
+void RenderPoster();
+void* PosterWorker(void *arg);
+void WritePosterIFD(struct Poster *poster);
+void HueToRGB(float hue, unsigned char *rgb);
+
+void MakeFrameKey(struct FrameKey *key, float power, float cR, float cI);
+void CachePath(const struct FrameKey *key, char *path, size_t size);
+int CacheLoad(const struct FrameKey *key, float *values, float *histogram);
+void CacheStore(const struct FrameKey *key, const float *values, const float *histogram);
+void CacheEvict();
+uint64_t Hash64(const void *data, size_t length);
+
+void RenderAtlas();
+void* AtlasWorker(void *arg);
+
+void AutoTune();
+int LoadTuneProfile();
+void SetPoolThreads(int threads);
+void TuneProfilePath(char *path, size_t size);
+
+void ZoomAnimation();
+void ZoomView(double t, double *centerX, double *centerY, double *range, float *power);
+int Reproject(float *values, double *sampleRe, double *sampleIm, const float *prevValues, const double *prevRe, const double *prevIm, double prevMinX, double prevMinY, double prevStep, int havePrev, double minX, double minY, double step, float power);
+void WriteZoomFrame(float *nums, int frame, float power, int frames);
+
+void SchedulerStart(int threads);
+void SchedulerStop();
+void* SchedulerWorker(void *arg);
+struct Job* JobNew(int kind, int priority);
+void JobSubmit(struct Job *job);
+struct Job* SubmitFrame(float power, float cR, float cI, int priority);
+struct Job* SubmitTile(struct TileKey key, int priority);
+struct Job* SubmitSweep(int firstFrame, int frames, void (*frameDone)(int frame, float *values, float *histogram), int priority);
+struct Job* JobTake(int lowest);
+void JobRun(struct Job *job);
+int JobWait(struct Job *job);
+void JobCancel(struct Job *job);
+void JobRelease(struct Job *job);
+int JobCheckpoint();
+int JobCancelled();
+void ScheduledSweep();
+void* TileServerThread(void *arg);
+void SweepFrameDone(int frame, float *values, float *histogram);
+
+void PublishDzi(const float *nums, int frame);
+void DziRun(struct DziTask *task, int count, void (*body)(struct DziTask *task, int index));
+void* DziWorker(void *arg);
+void DziColorRow(struct DziTask *task, int y);
+void DziDownsampleRow(struct DziTask *task, int y);
+void DziTile(struct DziTask *task, int index);
+void DziTilePath(char *path, size_t size, int frame, int level, int col, int row);
+int WritePNG(const char *path, const unsigned char *rgb, int stride, int width, int height);
+uint32_t Crc32(uint32_t crc, const unsigned char *data, size_t length);
+void CrcTable();
+
+void SweepStats();
+void* StatsWorker(void *arg);
+void FrameStats(float power, int *columns, struct StatsRecord *record, uint32_t *histogram);
+
+void PublishShm(const float *values, const float *nums, int frame, float power);
+void ShmStop();
+void ShmWake(_Atomic uint32_t *word);
+
+void EstimateSweep();
+int LoadShard(int shard, int *first, int *last);
+
+void MeasureSpacing();
+int LoadSpacing();
+
+void CertifiedMandelbrot(float *values, float *histogram, float power, float cR, float cI);
+struct Certificate* CertificateGet(int block, float cR, float cI);
+void CertifyColumn(struct Certificate *certificate, int i);
+void BlockPowers(int block, float *powerLo, float *powerHi);
+int FrameIndex(float power);
+
 char* GetPath(int index);
 
 int main(){
     //initialization of variables
-    float nums[WIDTH * HEIGHT];
-    float numFiles = DIVISIONS / PERFILE;
-    float values[WIDTH * HEIGHT];
-    float histogram[MAX_I];
-    int temp = 0;
     clock_t start, end;
     double cpuTimeUsed;
     int h, m, s;
+    int failures = 0;
 
     start = clock();
 
-    //Runs the algorithm for each power in the range
-    for(int i = 0; i < (int)numFiles + ceil((numFiles) - (int)numFiles); i++){
-      StartWriteToJSON(i);
-      if(i == 0){
-        Mandelbrot(values, histogram, START + i * ((END - START) / numFiles));
-        CalculateColors(values, histogram, nums);
-        MiddleWriteToJSON(nums, i);
-        printf("power: %f, %d/%d iterations, %f%%\n", START + i * ((END - START) / numFiles), 0, DIVISIONS, 0.0);
-      }
-      for(float j = START + i * ((END - START) / numFiles) + INCREMENT; ((int)(j * 100000 + 0.5))/100000.0 < (START + (i + 1) * ((END - START) / numFiles)); j += INCREMENT){
-        j = (((int)(fabs(j) * 100000 + 0.5))/100000.0) * ((j > 0) ? 1 : -1);
-        // Note: Power is divided by DIVISIONS
-        Mandelbrot(values, histogram, j);
-        CalculateColors(values, histogram, nums);
-        MiddleWriteToJSON(nums, i);
-        temp = (int)round(((j-START)/(float)(END - START)) * DIVISIONS);
-        printf("power: %f, %d/%d iterations, %f%%\n", j, temp, DIVISIONS, (100.0 * temp) / DIVISIONS);
-      }
-      Mandelbrot(values, histogram, (START + (i + 1) * ((END - START) / numFiles)));
-      CalculateColors(values, histogram, nums);
-      LastWriteToJSON(nums, i);
-      printf("power: %f, %d/%d iterations, %f%%\n", (START + (i + 1) * ((END - START) / numFiles)), (int)(((i + 1) * numFiles) / 10), DIVISIONS, (10 * (1 + i) * numFiles) / DIVISIONS);
-      FinishWriteToJSON(i);
+    if(!TUNE && LoadTuneProfile()){
+      printf("Using %d compute, %d color and %d encode threads and %d frames in flight from the tuning profile\n", COMPUTE_THREADS, COLOR_THREADS, ENCODE_THREADS, FRAMES_IN_FLIGHT);
+    }
+    if(BAILOUT && CERTIFY){
+      printf("CERTIFY proves escape counts for radius 4, turn BAILOUT or CERTIFY off\n");
+      return 1;
+    }
+    if(USE_SPACING && !ADAPTIVE_SPACING && !LoadSpacing()){
+      printf("No spacing for this sweep in %s, run with ADAPTIVE_SPACING = 1 first\n", SPACING_PATH);
+      return 1;
+    }
+
+    if(TUNE){
+      AutoTune();
+    }else if(ADAPTIVE_SPACING){
+      MeasureSpacing();
+    }else if(ESTIMATE){
+      EstimateSweep();
+    }else if(ACCURACY){
+      //BAILOUT changes the escape counts on purpose, so it gets checked for the same set instead
+      failures = BAILOUT ? BailoutCheck() : AccuracyCheck(ReferenceKernel, EscapeKernel, 1);
+      if(CERTIFY) failures += AccuracyCheck(ReferenceKernel, CertifiedKernel, CERTIFY_BLOCK);
+    }else if(SCHEDULER){
+      ScheduledSweep();
+    }else if(ZOOM){
+      ZoomAnimation();
+    }else if(STATS){
+      SweepStats();
+    }else if(ATLAS){
+      RenderAtlas();
+    }else if(POSTER){
+      RenderPoster();
+    }else if(TILE_SERVER){
+      TileServer();
+    }else if(PREVIEW){
+      Preview();
+    }else if(PIPELINE){
+      SweepPipeline();
+    }else if(ARCHIVE){
+      SweepToArchive();
+    }else{
+      SweepToJSON();
     }
+    if(SHM) ShmStop();
 
     // StartWriteToJSON(1005);
     // Mandelbrot(values, histogram, -9.5);
@@ -115,36 +775,153 @@ int main(){
     m = (cpuTimeUsed -(3600*h))/60;
 	  s = (cpuTimeUsed -(3600*h)-(m*60));
     printf("The program took %d:%d:%d to run.\n", h, m, s);
-    return 0;
+    return failures > 0;
+}
+
+//The original sweep, writes PERFILE frames to each JSON file
+void SweepToJSON(){
+  float nums[WIDTH * HEIGHT];
+  float numFiles = DIVISIONS / PERFILE;
+  float values[WIDTH * HEIGHT];
+  float histogram[MAX_I];
+  int temp = 0;
+
+  //Its powers come from adding up INCREMENT, not from FramePower(), so it can't follow a spacing
+  if(USE_SPACING){
+    printf("USE_SPACING needs PIPELINE, ARCHIVE, SCHEDULER or STATS, this sweep always spaces frames INCREMENT apart\n");
+    exit(1);
+  }
+
+  //Runs the algorithm for each power in the range
+  for(int i = 0; i < (int)numFiles + ceil((numFiles) - (int)numFiles); i++){
+    StartWriteToJSON(i);
+    if(i == 0){
+      RenderFrame(values, histogram, START + i * ((END - START) / numFiles), 0, 0);
+      CalculateColors(values, histogram, nums);
+      if(DZI) PublishDzi(nums, 0);
+      if(SHM) PublishShm(values, nums, 0, START);
+      MiddleWriteToJSON(nums, i);
+      printf("power: %f, %d/%d iterations, %f%%\n", START + i * ((END - START) / numFiles), 0, DIVISIONS, 0.0);
+    }
+    for(float j = START + i * ((END - START) / numFiles) + INCREMENT; ((int)(j * 100000 + 0.5))/100000.0 < (START + (i + 1) * ((END - START) / numFiles)); j += INCREMENT){
+      j = (((int)(fabs(j) * 100000 + 0.5))/100000.0) * ((j > 0) ? 1 : -1);
+      // Note: Power is divided by DIVISIONS
+      RenderFrame(values, histogram, j, 0, 0);
+      CalculateColors(values, histogram, nums);
+      temp = (int)round(((j-START)/(float)(END - START)) * DIVISIONS);
+      if(DZI) PublishDzi(nums, temp);
+      if(SHM) PublishShm(values, nums, temp, j);
+      MiddleWriteToJSON(nums, i);
+      printf("power: %f, %d/%d iterations, %f%%\n", j, temp, DIVISIONS, (100.0 * temp) / DIVISIONS);
+    }
+    RenderFrame(values, histogram, (START + (i + 1) * ((END - START) / numFiles)), 0, 0);
+    CalculateColors(values, histogram, nums);
+    if(DZI) PublishDzi(nums, (int)round((i + 1) * PERFILE));
+    if(SHM) PublishShm(values, nums, (int)round((i + 1) * PERFILE), START + (i + 1) * ((END - START) / numFiles));
+    LastWriteToJSON(nums, i);
+    printf("power: %f, %d/%d iterations, %f%%\n", (START + (i + 1) * ((END - START) / numFiles)), (int)(((i + 1) * numFiles) / 10), DIVISIONS, (10 * (1 + i) * numFiles) / DIVISIONS);
+    FinishWriteToJSON(i);
+  }
+}
+
+//Same frames as the JSON sweep, but all of them go into one archive file
+void SweepToArchive(){
+  float *nums = malloc(sizeof(float) * WIDTH * HEIGHT);
+  float *values = malloc(sizeof(float) * WIDTH * HEIGHT);
+  float histogram[MAX_I];
+  struct Archive archive;
+
+  if(ArchiveOpen(&archive, ARCHIVE_PATH, DIVISIONS + 1, 0) != 0){
+    printf("Could not open %s\n", ARCHIVE_PATH);
+    free(nums);
+    free(values);
+    return;
+  }
+
+  for(int i = 0; i <= DIVISIONS; i++){
+    float power = FramePower(i);
+    for(int k = 0; k < MAX_I; k++){
+      histogram[k] = 0;
+    }
+    RenderFrame(values, histogram, power, 0, 0);
+    CalculateColors(values, histogram, nums);
+    if(DZI) PublishDzi(nums, i);
+    if(SHM) PublishShm(values, nums, i, power);
+    if(ArchiveAppend(&archive, power, nums, WIDTH * HEIGHT) != 0){
+      printf("Could not write frame %d to %s\n", i, ARCHIVE_PATH);
+      exit(1);
+    }
+    printf("power: %f, %d/%d iterations, %f%%\n", power, i, DIVISIONS, (100.0 * i) / DIVISIONS);
+  }
+
+  if(ArchiveClose(&archive) != 0){
+    printf("Could not write %s\n", ARCHIVE_PATH);
+    exit(1);
+  }
+  free(nums);
+  free(values);
+}
+
+//Powers of every frame from SPACING_PATH, NULL if the frames are INCREMENT apart
+float *spacedPowers = NULL;
+
+//Power of a given frame, rounded to 5 decimal places like the JSON sweep does (unless it came from SPACING_PATH)
+float FramePower(int frame){
+  float power = START + frame * INCREMENT;
+  if(spacedPowers != NULL) return spacedPowers[frame];
+  return (((int)(fabs(power) * 100000 + 0.5))/100000.0) * ((power > 0) ? 1 : -1);
+}
+
+//JSON file a frame goes in: PERFILE frames to a file, and the first file also gets frame 0
+int FrameFile(int frame){
+  return (frame == 0) ? 0 : (frame - 1) / (int)PERFILE;
+}
+
+//First and last frame of a JSON file
+int FileFirstFrame(int file){
+  return (file == 0) ? 0 : file * (int)PERFILE + 1;
+}
+
+int FileLastFrame(int file){
+  int last = (file + 1) * (int)PERFILE;
+  return (last < DIVISIONS) ? last : DIVISIONS;
+}
+
+//The frame (out of 0 to last) rendered position-th with COARSE_TO_FINE: first every multiple of COARSE_STEP
+//(0 included), then for each step s from COARSE_STEP / 2 down to 1 the frames that are odd multiples of s
+int FrameOrder(int position, int last){
+  int step = COARSE_STEP;
+  int count = last / step + 1;
+
+  if(position < count) return position * step;
+  position -= count;
+  for(step /= 2; step >= 1; step /= 2){
+    count = (last >= step) ? (last - step) / (2 * step) + 1 : 0;
+    if(position < count) return step + position * 2 * step;
+    position -= count;
+  }
+  return -1;
+}
+
+//The pass of FrameOrder() a frame gets rendered in, given as the spacing between frames in that pass
+int CoarseStep(int frame){
+  if(frame == 0 || (frame & -frame) > COARSE_STEP) return COARSE_STEP;
+  return frame & -frame;
 }
 
 void Mandelbrot(float *values, float *histogram, float power, float cR, float cI){
-  struct Complex com1;
-  struct Complex com2;
   int n = 0;
   float re, im;
 
   //Runs the algorithm for each pixel on the screen, mapped between the constraints
   for(int i = 0; i < WIDTH; i++){
+    //Stops if the scheduler cancelled this frame
+    if(JobCheckpoint()) return;
     for(int j = 0; j < HEIGHT; j++){
       re = map(i, 0, WIDTH, MIN_X, MAX_X);
       im = map(j, 0, HEIGHT, MIN_Y, MAX_Y);
 
-      com1.re = re;
-      com1.im = im;
-      com2.re = re;
-      com2.im = im;
-
-      n = 0;
-
-      //If the modulus of the complex number (the distance between it and the origin) is
-      //greater than 4, break b/c it will go to infinity. If the point has reached n, it is considered 'in'.
-      while(n < MAX_I && sqrt(com1.re * com1.re + com1.im * com1.im) < 4) {
-        // printf("%f + %fi, %f + %fi\n", com1.re, com1.im, Power(com1, power).re, Power(com1, power).im);
-        com1 = Alg(com1, com2, power, cR, cI);
-
-        n++;
-      }
+      n = Escape(re, im, power, cR, cI, MAX_I);
 
       //Calculates data for the color algorithm
       values[i * HEIGHT + j] = n;
@@ -155,21 +932,20 @@ void Mandelbrot(float *values, float *histogram, float power, float cR, float cI
   }
 }
 
+//Runs the algorithm for a single point, returns how many iterations it took to escape (maxI if it never did).
+//The loop itself lives in the library (GeneralizedMandelbrotLib.c) so both always match.
+int Escape(float re, float im, float power, float cR, float cI, int maxI){
+  float zRe = re, zIm = im;
+
+  if(!BAILOUT) return MandelbrotEscape(re, im, power, cR, cI, maxI);
+  return MandelbrotResumeWithin(re, im, power, cR, cI, maxI, &zRe, &zIm, 0, MandelbrotBailout(re, im, power, cR, cI));
+}
+
 //Color algorithm to eleminate stark borders in the visualization.
 //I got this from Wikipedia I think, I honestly can't remember how it works now :S
 void CalculateColors(float *values, float *histogram, float *arr){
-  int total = 0;
   float hues[MAX_I];
-  float h = 0;
-  for(int i = 0; i < MAX_I; i++){
-    total += histogram[i];
-  }
-
-  for(int i = 0; i < MAX_I; i++){
-    h += histogram[i] / total;
-    hues[i] = h;
-  }
-  hues[MAX_I - 1] = h;
+  Hues(histogram, hues, MAX_I);
 
   // printf("%f + %fi, %d\n", com1.re, com1.im, n);
   for(int i = 0; i < WIDTH; i++){
@@ -179,12 +955,29 @@ void CalculateColors(float *values, float *histogram, float *arr){
         arr[i * HEIGHT + j] = NAN;
       }else {
         // arr[i * HEIGHT + j] = (255 * (n + 1 - log(log2(sqrt(com1.re * com1.re + com1.im * com1.im))))) / MAX_I;
-        arr[i * HEIGHT + j] = 255 - (255 * LinearInterpolation(hues[(int)currentVal], hues[(int)ceil(currentVal)], (int)currentVal % 1));
+        //Antialiased pixels can land between two escape counts, so blend their hues
+        int upper = ((int)ceil(currentVal) < MAX_I) ? (int)ceil(currentVal) : MAX_I - 1;
+        arr[i * HEIGHT + j] = 255 - (255 * LinearInterpolation(hues[(int)currentVal], hues[upper], currentVal - (int)currentVal));
       }
     }
   }
 }
 
+//Running share of the escaped pixels that took i iterations or less, this is what the colors come from
+void Hues(const float *histogram, float *hues, int maxI){
+  int total = 0;
+  float h = 0;
+  for(int i = 0; i < maxI; i++){
+    total += histogram[i];
+  }
+
+  for(int i = 0; i < maxI; i++){
+    h += histogram[i] / total;
+    hues[i] = h;
+  }
+  hues[maxI - 1] = h;
+}
+
 //var1 is to (end1 - start1) as RETURN is to (end2 - start2)
 float map(float var1, float start1, float end1, float start2, float end2){
   return start2 + (var1 * (fabs(end2) + fabs(start2))) / (fabs(end1) + fabs(start1));
@@ -228,7 +1021,11 @@ void MiddleWriteToJSON(float *arr, int index){
     fputs(", ", fp);
   }
 
-  fprintf(fp, "%f", arr[WIDTH * HEIGHT]);
+  if(arr[WIDTH * HEIGHT - 1] == arr[WIDTH * HEIGHT - 1]){
+    fprintf(fp, "%f", arr[WIDTH * HEIGHT - 1]);
+  }else{
+    fputs("NaN", fp);
+  }
 
   fputs("\t],\n", fp);
 
@@ -251,7 +1048,11 @@ void LastWriteToJSON(float *arr, int index){
     fputs(", ", fp);
   }
 
-  fprintf(fp, "%f", arr[WIDTH * HEIGHT]);
+  if(arr[WIDTH * HEIGHT - 1] == arr[WIDTH * HEIGHT - 1]){
+    fprintf(fp, "%f", arr[WIDTH * HEIGHT - 1]);
+  }else{
+    fputs("NaN", fp);
+  }
 
   fputs("\t]\n", fp);
 
@@ -267,6 +1068,3427 @@ void FinishWriteToJSON(int index){
   fclose(fp);
 }
 
+//Creates the archive and reserves room in the index for capacity frames, flags is 0 or ARCHIVE_ZOOM
+int ArchiveOpen(struct Archive *archive, const char *path, int capacity, uint32_t flags){
+  struct ArchiveEntry empty = {0, 0, 0, 0};
+  uint64_t dataStart = sizeof(struct ArchiveHeader) + (uint64_t)capacity * sizeof(struct ArchiveEntry);
+
+  archive->fp = fopen(path, "wb+");
+  if(archive->fp == NULL) return -1;
+
+  archive->header.magic = ARCHIVE_MAGIC;
+  archive->header.version = ARCHIVE_VERSION;
+  archive->header.width = WIDTH;
+  archive->header.height = HEIGHT;
+  archive->header.capacity = capacity;
+  archive->header.count = 0;
+  archive->header.flags = flags;
+  archive->header.unused = 0;
+  archive->end = (dataStart + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+
+  if(fwrite(&archive->header, sizeof(struct ArchiveHeader), 1, archive->fp) != 1){
+    fclose(archive->fp);
+    return -1;
+  }
+  for(int i = 0; i < capacity; i++){
+    if(fwrite(&empty, sizeof(struct ArchiveEntry), 1, archive->fp) != 1){
+      fclose(archive->fp);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+//Writes the frame at the end of the file, then fills in its index entry and the frame count.
+//The frame goes down before the index does, so a reader never sees an entry without its data.
+int ArchiveAppend(struct Archive *archive, float power, const float *arr, int length){
+  struct ArchiveEntry entry;
+  uint32_t frame = archive->header.count;
+
+  if(frame >= archive->header.capacity) return -1;
+
+  entry.power = power;
+  entry.length = (uint64_t)length * sizeof(float);
+  entry.offset = archive->end;
+  entry.checksum = ArchiveChecksum(arr, entry.length);
+
+  //Each part is flushed before the next one points at it: the data before its index entry, and the
+  //entry before the header counts it, so a reader mapping the file mid sweep never sees a half written frame
+  if(fseek(archive->fp, entry.offset, SEEK_SET) != 0) return -1;
+  if(fwrite(arr, 1, entry.length, archive->fp) != entry.length || fflush(archive->fp) != 0) return -1;
+  archive->end = (entry.offset + entry.length + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+
+  if(fseek(archive->fp, sizeof(struct ArchiveHeader) + (uint64_t)frame * sizeof(struct ArchiveEntry), SEEK_SET) != 0) return -1;
+  if(fwrite(&entry, sizeof(struct ArchiveEntry), 1, archive->fp) != 1 || fflush(archive->fp) != 0) return -1;
+
+  archive->header.count++;
+  if(fseek(archive->fp, 0, SEEK_SET) != 0) return -1;
+  if(fwrite(&archive->header, sizeof(struct ArchiveHeader), 1, archive->fp) != 1 || fflush(archive->fp) != 0) return -1;
+  return 0;
+}
+
+//Returns -1 if what was still buffered couldn't be written
+int ArchiveClose(struct Archive *archive){
+  int result = fclose(archive->fp);
+  archive->fp = NULL;
+  return (result == 0) ? 0 : -1;
+}
+
+//Gives every frame its place in the file up front, for writing them out of order with ArchivePut().
+//The index is filled with every frame's power (so ArchiveFind() works) and a length of 0 until its frame is written.
+//Entry k is for frame first + k of the sweep.
+int ArchiveReserve(struct Archive *archive, int length, float (*power)(int frame), int first){
+  uint64_t stride = ((uint64_t)length * sizeof(float) + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+
+  if(fseek(archive->fp, sizeof(struct ArchiveHeader), SEEK_SET) != 0) return -1;
+  for(uint32_t k = 0; k < archive->header.capacity; k++){
+    struct ArchiveEntry entry = {power(first + k), 0, archive->end + k * stride, 0};
+    if(fwrite(&entry, sizeof(struct ArchiveEntry), 1, archive->fp) != 1) return -1;
+  }
+  archive->header.count = archive->header.capacity;
+  if(fseek(archive->fp, 0, SEEK_SET) != 0) return -1;
+  if(fwrite(&archive->header, sizeof(struct ArchiveHeader), 1, archive->fp) != 1 || fflush(archive->fp) != 0) return -1;
+  return 0;
+}
+
+//Writes a frame into the place ArchiveReserve() gave it, data first and then the index entry like ArchiveAppend()
+int ArchivePut(struct Archive *archive, int frame, float power, const float *arr, int length){
+  struct ArchiveEntry entry;
+  uint64_t stride = ((uint64_t)length * sizeof(float) + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+
+  if(frame < 0 || (uint32_t)frame >= archive->header.capacity) return -1;
+  entry.power = power;
+  entry.length = (uint64_t)length * sizeof(float);
+  entry.offset = archive->end + frame * stride;
+  entry.checksum = ArchiveChecksum(arr, entry.length);
+
+  if(fseek(archive->fp, entry.offset, SEEK_SET) != 0) return -1;
+  if(fwrite(arr, 1, entry.length, archive->fp) != entry.length || fflush(archive->fp) != 0) return -1;
+  if(fseek(archive->fp, sizeof(struct ArchiveHeader) + (uint64_t)frame * sizeof(struct ArchiveEntry), SEEK_SET) != 0) return -1;
+  if(fwrite(&entry, sizeof(struct ArchiveEntry), 1, archive->fp) != 1 || fflush(archive->fp) != 0) return -1;
+  return 0;
+}
+
+struct TileCache tileCache = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+//Serves tiles over HTTP on localhost:
+//  GET /tile?power=2&zoom=3&x=1&y=4&maxi=80 returns TILE_SIZE*TILE_SIZE floats (the escape counts)
+//  GET /viewport?power=2&zoom=3&x0=0&y0=0&x1=7&y1=7 tells the server which tiles are on screen
+void TileServer(){
+  struct sockaddr_in addr;
+  pthread_t thread;
+  int one = 1;
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+
+  signal(SIGPIPE, SIG_IGN);
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(TILE_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if(bind(server, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 64) != 0){
+    printf("Could not listen on port %d\n", TILE_PORT);
+    close(server);
+    return;
+  }
+
+  for(int i = 0; i < TILE_THREADS; i++){
+    pthread_create(&thread, NULL, TileWorker, NULL);
+    pthread_detach(thread);
+  }
+
+  printf("Serving tiles on http://127.0.0.1:%d\n", TILE_PORT);
+  for(;;){
+    int client = accept(server, NULL, NULL);
+    if(client < 0) continue;
+    if(pthread_create(&thread, NULL, TileConnection, (void*)(intptr_t)client) != 0){
+      close(client);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+}
+
+//Handles one request, then closes the connection
+void* TileConnection(void *arg){
+  int client = (int)(intptr_t)arg;
+  char request[2048];
+  char header[256];
+  ssize_t got = read(client, request, sizeof(request) - 1);
+  char *query;
+
+  if(got <= 0){
+    close(client);
+    return NULL;
+  }
+  request[got] = '\0';
+  query = strchr(request, '?');
+  if(query == NULL) query = "";
+
+  if(strncmp(request, "GET /tile?", 10) == 0){
+    struct TileKey key;
+    size_t bytes = sizeof(float) * TILE_SIZE * TILE_SIZE;
+    float *data;
+
+    key.power = QueryParam(query, "power", 2);
+    key.zoom = (int)QueryParam(query, "zoom", 0);
+    key.x = (int)QueryParam(query, "x", 0);
+    key.y = (int)QueryParam(query, "y", 0);
+    key.maxI = (int)QueryParam(query, "maxi", MAX_I);
+    if(key.zoom < 0 || key.zoom > 24 || key.x < 0 || key.y < 0 || key.x >= (1 << key.zoom) || key.y >= (1 << key.zoom) || key.maxI < 1){
+      WriteText(client, "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n");
+      close(client);
+      return NULL;
+    }
+
+    data = TileGet(key);
+    if(data == NULL){
+      //Cancelled because the viewer moved on to another power or zoom
+      WriteText(client, "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\n\r\n");
+      close(client);
+      return NULL;
+    }
+    snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %zu\r\nX-Tile-Size: %d\r\nConnection: close\r\n\r\n", bytes, TILE_SIZE);
+    if(WriteAll(client, header, strlen(header)) == 0) WriteAll(client, data, bytes);
+    free(data);
+  }else if(strncmp(request, "GET /viewport?", 14) == 0){
+    pthread_mutex_lock(&tileCache.lock);
+    tileCache.hasViewport = 1;
+    tileCache.viewPower = QueryParam(query, "power", 2);
+    tileCache.viewZoom = (int)QueryParam(query, "zoom", 0);
+    tileCache.viewX0 = (int)QueryParam(query, "x0", 0);
+    tileCache.viewY0 = (int)QueryParam(query, "y0", 0);
+    tileCache.viewX1 = (int)QueryParam(query, "x1", 0);
+    tileCache.viewY1 = (int)QueryParam(query, "y1", 0);
+    if(SCHEDULER) TileCancelStale();
+    pthread_mutex_unlock(&tileCache.lock);
+    WriteText(client, "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n");
+  }else{
+    WriteText(client, "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n");
+  }
+
+  close(client);
+  return NULL;
+}
+
+unsigned TileHash(const struct TileKey *key){
+  uint32_t bits;
+  unsigned hash;
+  memcpy(&bits, &key->power, sizeof(bits));
+  hash = bits * 2654435761u;
+  hash ^= key->zoom * 40503u + key->x * 73856093u + key->y * 19349663u + key->maxI * 83492791u;
+  return hash % TILE_BUCKETS;
+}
+
+int TileKeyEqual(const struct TileKey *a, const struct TileKey *b){
+  return a->power == b->power && a->zoom == b->zoom && a->x == b->x && a->y == b->y && a->maxI == b->maxI;
+}
+
+//Returns a copy of the tile the caller has to free. Renders it if it isn't cached,
+//or waits for it if another request is already rendering it.
+//Returns NULL if the tile got cancelled by TileCancelStale() before it was ready.
+float* TileGet(struct TileKey key){
+  size_t bytes = sizeof(float) * TILE_SIZE * TILE_SIZE;
+  unsigned bucket = TileHash(&key);
+  float *copy = malloc(bytes);
+  struct Tile *tile;
+
+  pthread_mutex_lock(&tileCache.lock);
+  for(tile = tileCache.buckets[bucket]; tile != NULL; tile = tile->hashNext){
+    if(TileKeyEqual(&tile->key, &key)) break;
+  }
+
+  if(tile == NULL){
+    tile = calloc(1, sizeof(struct Tile));
+    tile->key = key;
+    tile->state = TILE_PENDING;
+    tile->hashNext = tileCache.buckets[bucket];
+    tileCache.buckets[bucket] = tile;
+    tile->next = tileCache.queue;
+    if(tileCache.queue != NULL) tileCache.queue->prev = tile;
+    tileCache.queue = tile;
+    pthread_cond_signal(&tileCache.work);
+  }else if(tile->state == TILE_READY && tile != tileCache.newest){
+    //Move it to the front of the LRU list
+    tile->prev->next = tile->next;
+    if(tile->next != NULL) tile->next->prev = tile->prev;
+    else tileCache.oldest = tile->prev;
+    tile->prev = NULL;
+    tile->next = tileCache.newest;
+    tileCache.newest->prev = tile;
+    tileCache.newest = tile;
+  }
+
+  tile->waiters++;
+  while(tile->state != TILE_READY && tile->state != TILE_CANCELLED){
+    pthread_cond_wait(&tileCache.ready, &tileCache.lock);
+  }
+  tile->waiters--;
+  if(tile->state == TILE_CANCELLED){
+    //Cancelled tiles are already out of the cache, the last one waiting frees it
+    if(tile->waiters == 0 && tile->job == NULL) free(tile);
+    pthread_mutex_unlock(&tileCache.lock);
+    free(copy);
+    return NULL;
+  }
+  memcpy(copy, tile->data, bytes);
+  pthread_mutex_unlock(&tileCache.lock);
+  return copy;
+}
+
+//Takes the most important pending tile off the queue, renders it, and adds it to the cache
+void* TileWorker(void *arg){
+  size_t bytes = sizeof(float) * TILE_SIZE * TILE_SIZE;
+
+  pthread_mutex_lock(&tileCache.lock);
+  for(;;){
+    struct Tile *tile = NULL;
+    int best = INT32_MAX;
+    float *data;
+
+    while(tileCache.queue == NULL){
+      pthread_cond_wait(&tileCache.work, &tileCache.lock);
+    }
+    for(struct Tile *t = tileCache.queue; t != NULL; t = t->next){
+      int priority = TilePriority(&t->key);
+      if(priority < best){
+        best = priority;
+        tile = t;
+      }
+    }
+
+    if(tile->prev != NULL) tile->prev->next = tile->next;
+    else tileCache.queue = tile->next;
+    if(tile->next != NULL) tile->next->prev = tile->prev;
+    tile->prev = NULL;
+    tile->next = NULL;
+    tile->state = TILE_RENDERING;
+    //Rendered by the scheduler as an interactive job, so it goes ahead of the sweep. The job is submitted
+    //before the lock is let go, so TileCancelStale() never sees the tile rendering without a job to cancel.
+    if(SCHEDULER) tile->job = SubmitTile(tile->key, JOB_INTERACTIVE);
+    pthread_mutex_unlock(&tileCache.lock);
+
+    data = malloc(bytes);
+    if(SCHEDULER){
+      struct Job *job = tile->job;
+      int state = JobWait(job);
+
+      memcpy(data, job->values, bytes);
+
+      pthread_mutex_lock(&tileCache.lock);
+      tile->job = NULL;
+      JobRelease(job);
+      if(state == JOB_CANCELLED){
+        TileUnlink(tile);
+        tile->state = TILE_CANCELLED;
+        if(tile->waiters == 0) free(tile);
+        free(data);
+        pthread_cond_broadcast(&tileCache.ready);
+        continue;
+      }
+    }else{
+      RenderTile(tile->key, data);
+      pthread_mutex_lock(&tileCache.lock);
+    }
+
+    tile->data = data;
+    tile->state = TILE_READY;
+    tile->next = tileCache.newest;
+    if(tileCache.newest != NULL) tileCache.newest->prev = tile;
+    else tileCache.oldest = tile;
+    tileCache.newest = tile;
+    tileCache.bytes += bytes;
+    TileEvict();
+    pthread_cond_broadcast(&tileCache.ready);
+  }
+  return arg;
+}
+
+//Lower is more important. Tiles on screen come first, then the ones closest to the screen.
+int TilePriority(const struct TileKey *key){
+  int dx, dy;
+
+  if(!tileCache.hasViewport) return 0;
+  if(key->power != tileCache.viewPower || key->zoom != tileCache.viewZoom){
+    return (1 << 20) + abs(key->zoom - tileCache.viewZoom);
+  }
+
+  dx = (key->x < tileCache.viewX0) ? tileCache.viewX0 - key->x : (key->x > tileCache.viewX1) ? key->x - tileCache.viewX1 : 0;
+  dy = (key->y < tileCache.viewY0) ? tileCache.viewY0 - key->y : (key->y > tileCache.viewY1) ? key->y - tileCache.viewY1 : 0;
+  return (dx > dy) ? dx : dy;
+}
+
+//Drops the least recently used tiles until the cache fits in TILE_CACHE_BYTES.
+//Tiles someone is still waiting to copy are skipped. Must be called with the lock held.
+void TileEvict(){
+  struct Tile *tile = tileCache.oldest;
+  size_t bytes = sizeof(float) * TILE_SIZE * TILE_SIZE;
+
+  while(tileCache.bytes > TILE_CACHE_BYTES && tile != NULL){
+    struct Tile *newer = tile->prev;
+    if(tile->waiters == 0){
+      TileUnlink(tile);
+
+      if(newer != NULL) newer->next = tile->next;
+      else tileCache.newest = tile->next;
+      if(tile->next != NULL) tile->next->prev = newer;
+      else tileCache.oldest = newer;
+
+      tileCache.bytes -= bytes;
+      free(tile->data);
+      free(tile);
+    }
+    tile = newer;
+  }
+}
+
+//Takes a tile out of the hash table. Must be called with the lock held.
+void TileUnlink(struct Tile *tile){
+  struct Tile **link = &tileCache.buckets[TileHash(&tile->key)];
+  while(*link != tile) link = &(*link)->hashNext;
+  *link = tile->hashNext;
+}
+
+//Cancels every tile that isn't for the viewport's power and zoom anymore: queued ones are dropped
+//right away and ones being rendered stop at the next column. Whoever asked for them gets a 503.
+//Must be called with the lock held.
+void TileCancelStale(){
+  for(int b = 0; b < TILE_BUCKETS; b++){
+    struct Tile *tile = tileCache.buckets[b];
+    while(tile != NULL){
+      struct Tile *next = tile->hashNext;
+      if(TilePriority(&tile->key) >= (1 << 20)){
+        if(tile->state == TILE_PENDING){
+          if(tile->prev != NULL) tile->prev->next = tile->next;
+          else tileCache.queue = tile->next;
+          if(tile->next != NULL) tile->next->prev = tile->prev;
+          TileUnlink(tile);
+          tile->state = TILE_CANCELLED;
+          if(tile->waiters == 0) free(tile);
+        }else if(tile->state == TILE_RENDERING && tile->job != NULL){
+          JobCancel(tile->job);
+        }
+      }
+      tile = next;
+    }
+  }
+  pthread_cond_broadcast(&tileCache.ready);
+}
+
+//Same as Mandelbrot(), but only for the pixels in one tile
+void RenderTile(struct TileKey key, float *data){
+  float spanX = RANGE_X / (float)(1 << key.zoom);
+  float spanY = RANGE_Y / (float)(1 << key.zoom);
+
+  for(int i = 0; i < TILE_SIZE; i++){
+    if(JobCheckpoint()) return;
+    for(int j = 0; j < TILE_SIZE; j++){
+      float re = MIN_X + key.x * spanX + i * spanX / TILE_SIZE;
+      float im = MIN_Y + key.y * spanY + j * spanY / TILE_SIZE;
+      data[i * TILE_SIZE + j] = Escape(re, im, key.power, 0, 0, key.maxI);
+    }
+  }
+}
+
+//Reads name=value out of a query string like ?a=1&b=2
+float QueryParam(const char *query, const char *name, float fallback){
+  size_t length = strlen(name);
+  const char *p = query;
+
+  while(*p != '\0' && *p != ' '){
+    if((*p == '?' || *p == '&') && strncmp(p + 1, name, length) == 0 && p[length + 1] == '='){
+      return atof(p + length + 2);
+    }
+    p++;
+  }
+  return fallback;
+}
+
+int WriteAll(int fd, const void *data, size_t length){
+  const char *bytes = data;
+  while(length > 0){
+    ssize_t wrote = write(fd, bytes, length);
+    if(wrote <= 0) return -1;
+    bytes += wrote;
+    length -= wrote;
+  }
+  return 0;
+}
+
+int WriteText(int fd, const char *text){
+  return WriteAll(fd, text, strlen(text));
+}
+
+//Renders one frame with ProgressiveMandelbrot() and writes whatever it finished to the first JSON file
+void Preview(){
+  float *nums = malloc(sizeof(float) * WIDTH * HEIGHT);
+  float *values = malloc(sizeof(float) * WIDTH * HEIGHT);
+  float histogram[MAX_I];
+  int step = ProgressiveMandelbrot(values, histogram, PREVIEW_POWER, 0, 0, PREVIEW_SECONDS, NULL);
+
+  printf("power: %f, finished down to every %d pixels\n", PREVIEW_POWER, step);
+  CalculateColors(values, histogram, nums);
+  StartWriteToJSON(0);
+  LastWriteToJSON(nums, 0);
+  FinishWriteToJSON(0);
+  free(nums);
+  free(values);
+}
+
+//Same result as Mandelbrot(), but rendered coarse to fine. The first pass only runs every
+//PREVIEW_STEP pixels and fills the blocks in between, then each pass halves the step and
+//only runs the pixels the earlier passes haven't. If seconds is more than 0, it stops once
+//that much time has passed and values holds the best image finished by then (the first
+//pass always finishes, so there is always something to show).
+//pass (can be NULL) is called after every finished pass.
+//Returns the step of the last finished pass, 1 means the frame is exact.
+int ProgressiveMandelbrot(float *values, float *histogram, float power, float cR, float cI, double seconds, void (*pass)(float *values, int step)){
+  double deadline = Seconds() + seconds;
+  int finished = 0;
+
+  for(int step = PREVIEW_STEP; step >= 1; step /= 2){
+    int out = 0;
+
+    for(int i = 0; i < WIDTH && !out; i += step){
+      for(int j = 0; j < HEIGHT; j += step){
+        //Already sampled by a coarser pass
+        if(step != PREVIEW_STEP && i % (2 * step) == 0 && j % (2 * step) == 0) continue;
+        values[i * HEIGHT + j] = Escape(map(i, 0, WIDTH, MIN_X, MAX_X), map(j, 0, HEIGHT, MIN_Y, MAX_Y), power, cR, cI, MAX_I);
+      }
+      if(seconds > 0 && step != PREVIEW_STEP && Seconds() > deadline) out = 1;
+    }
+    if(out) break;
+
+    //Fills each block with the sample in its top left corner
+    if(step > 1){
+      for(int i = 0; i < WIDTH; i++){
+        for(int j = 0; j < HEIGHT; j++){
+          if(i % step != 0 || j % step != 0) values[i * HEIGHT + j] = values[(i - i % step) * HEIGHT + (j - j % step)];
+        }
+      }
+    }
+    finished = step;
+    if(pass != NULL) pass(values, step);
+  }
+
+  //The histogram is built from whatever ended up on screen so CalculateColors() works the same
+  for(int i = 0; i < MAX_I; i++){
+    histogram[i] = 0;
+  }
+  for(int i = 0; i < WIDTH * HEIGHT; i++){
+    if(values[i] < MAX_I) histogram[(int)values[i]]++;
+  }
+  return finished;
+}
+
+//Wall clock time in seconds
+double Seconds(){
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+//What the sweeps call to render a frame, Mandelbrot() plus whatever extras are turned on
+void RenderFrame(float *values, float *histogram, float power, float cR, float cI){
+  struct FrameKey key;
+  float *frameHistogram;
+
+  if(!FRAME_CACHE){
+    ComputeFrame(values, histogram, power, cR, cI);
+    return;
+  }
+
+  //The cache keeps each frame's own histogram, it gets added to the caller's like Mandelbrot() would
+  frameHistogram = calloc(MAX_I, sizeof(float));
+  MakeFrameKey(&key, power, cR, cI);
+  if(!CacheLoad(&key, values, frameHistogram)){
+    ComputeFrame(values, frameHistogram, power, cR, cI);
+    //Half a frame from a cancelled job must not end up in the cache
+    if(!JobCancelled()) CacheStore(&key, values, frameHistogram);
+  }
+  for(int i = 0; i < MAX_I; i++){
+    histogram[i] += frameHistogram[i];
+  }
+  free(frameHistogram);
+}
+
+//RenderFrame() without the cache
+void ComputeFrame(float *values, float *histogram, float power, float cR, float cI){
+  int budget = MAX_I;
+
+  if(ADAPTIVE) budget = AdaptiveMandelbrot(values, histogram, power, cR, cI);
+  else if(CONTINUE) ContinueMandelbrot(values, histogram, power, cR, cI);
+  else if(CERTIFY) CertifiedMandelbrot(values, histogram, power, cR, cI);
+  else Mandelbrot(values, histogram, power, cR, cI);
+  if(ANTIALIAS && !JobCancelled()) Antialias(values, power, cR, cI, budget);
+}
+
+//Mandelbrot() with an iteration budget picked for this frame. The probe runs every ADAPTIVE_STEP-th
+//pixel with the full MAX_I, then the budget is the smallest one (not below ADAPTIVE_MIN_I) that
+//still lets all but ADAPTIVE_QUALITY of the probe's escaping pixels escape. The rest of the frame
+//runs with that budget, the probe's pixels are kept. Pixels that hit the budget are stored as MAX_I
+//so CalculateColors() shows them as inside. Returns the budget.
+int AdaptiveMandelbrot(float *values, float *histogram, float power, float cR, float cI){
+  int *counts = calloc(MAX_I + 1, sizeof(int));
+  int escaped = 0, tail = 0, allowed, budget = MAX_I;
+
+  for(int i = 0; i < WIDTH; i += ADAPTIVE_STEP){
+    if(JobCheckpoint()) break;
+    for(int j = 0; j < HEIGHT; j += ADAPTIVE_STEP){
+      int n = Escape(map(i, 0, WIDTH, MIN_X, MAX_X), map(j, 0, HEIGHT, MIN_Y, MAX_Y), power, cR, cI, MAX_I);
+      values[i * HEIGHT + j] = n;
+      counts[n]++;
+      if(n < MAX_I) escaped++;
+    }
+  }
+
+  //Going down from MAX_I, tail is how many probe pixels a budget of b would show as inside by mistake
+  allowed = (int)(ADAPTIVE_QUALITY * escaped);
+  for(int b = MAX_I - 1; b >= ADAPTIVE_MIN_I; b--){
+    tail += counts[b];
+    if(tail > allowed) break;
+    budget = b;
+  }
+  if(budget == MAX_I && escaped > 0){
+    printf("power: %f still has points escaping at MAX_I (%d) iterations, it needs a higher MAX_I\n", power, MAX_I);
+  }
+
+  for(int i = 0; i < WIDTH; i++){
+    if(JobCheckpoint()) break;
+    for(int j = 0; j < HEIGHT; j++){
+      int n;
+      if(i % ADAPTIVE_STEP == 0 && j % ADAPTIVE_STEP == 0){
+        n = values[i * HEIGHT + j];
+      }else{
+        n = Escape(map(i, 0, WIDTH, MIN_X, MAX_X), map(j, 0, HEIGHT, MIN_Y, MAX_Y), power, cR, cI, budget);
+      }
+      if(n >= budget){
+        values[i * HEIGHT + j] = MAX_I;
+      }else{
+        values[i * HEIGHT + j] = n;
+        histogram[n]++;
+      }
+    }
+  }
+
+  free(counts);
+  return budget;
+}
+
+//Supersamples the pixels where the escape count jumps and replaces them with the average
+//escape count of their samples. Everywhere else one sample per pixel is already enough,
+//so this costs a small fraction of supersampling the whole frame.
+//maxI is the frame's iteration budget, samples that don't escape within it count as MAX_I like the pixels do.
+void Antialias(float *values, float power, float cR, float cI, int maxI){
+  int samples = AA_GRID * AA_GRID;
+  int count = 0;
+  struct Boundary *boundary = malloc(sizeof(struct Boundary) * WIDTH * HEIGHT);
+  float *averages;
+
+  //A pixel is on a boundary if any of its 4 neighbors escaped after a different number of iterations
+  for(int i = 0; i < WIDTH; i++){
+    for(int j = 0; j < HEIGHT; j++){
+      float n = values[i * HEIGHT + j];
+      float contrast = 0;
+      if(i > 0) contrast = fmax(contrast, fabs(n - values[(i - 1) * HEIGHT + j]));
+      if(i < WIDTH - 1) contrast = fmax(contrast, fabs(n - values[(i + 1) * HEIGHT + j]));
+      if(j > 0) contrast = fmax(contrast, fabs(n - values[i * HEIGHT + j - 1]));
+      if(j < HEIGHT - 1) contrast = fmax(contrast, fabs(n - values[i * HEIGHT + j + 1]));
+      if(contrast > 0){
+        boundary[count].index = i * HEIGHT + j;
+        boundary[count].contrast = contrast;
+        count++;
+      }
+    }
+  }
+
+  if((long)count * samples > AA_BUDGET){
+    qsort(boundary, count, sizeof(struct Boundary), CompareBoundary);
+    count = AA_BUDGET / samples;
+  }
+
+  //The averages are written back after all of them are done so the contrast above isn't thrown off
+  averages = malloc(sizeof(float) * (count > 0 ? count : 1));
+  for(int k = 0; k < count; k++){
+    int i = boundary[k].index / HEIGHT;
+    int j = boundary[k].index % HEIGHT;
+    float total = 0;
+    for(int a = 0; a < AA_GRID; a++){
+      for(int b = 0; b < AA_GRID; b++){
+        float re = map(i + (a + 0.5) / AA_GRID, 0, WIDTH, MIN_X, MAX_X);
+        float im = map(j + (b + 0.5) / AA_GRID, 0, HEIGHT, MIN_Y, MAX_Y);
+        int n = Escape(re, im, power, cR, cI, maxI);
+        total += (n >= maxI) ? MAX_I : n;
+      }
+    }
+    averages[k] = total / samples;
+  }
+  for(int k = 0; k < count; k++){
+    values[boundary[k].index] = averages[k];
+  }
+
+  free(averages);
+  free(boundary);
+}
+
+//Sorts boundary pixels from the biggest jump to the smallest
+int CompareBoundary(const void *a, const void *b){
+  float ca = ((const struct Boundary*)a)->contrast;
+  float cb = ((const struct Boundary*)b)->contrast;
+  return (ca < cb) - (ca > cb);
+}
+
+struct PipelineSlot *slots;
+struct Stage computeStage, colorStage, encodeStage, writeStage;
+atomic_int nextFrame;
+//Frames the pipeline renders, the whole sweep unless SHARD picks part of it
+int firstFrame, lastFrame;
+//One free ring per NUMA node in use, compute thread t works out of freeRings[t % slotNodes]
+struct Ring *freeRings;
+struct NumaNode *numaNodes;
+int slotNodes;
+atomic_int computeWorkers;
+
+//Runs the sweep with every stage on its own threads. Slots go round in a loop:
+//free -> compute -> color -> encode -> write -> free. When the free rings are empty the compute
+//threads wait, which is what keeps the memory at FRAMES_IN_FLIGHT frames.
+//The slots are split between the NUMA nodes, and each one only goes to compute threads pinned to
+//its node, so frames are rendered into memory on the same socket.
+void SweepPipeline(){
+  struct Ring computed, colored, encoded;
+  struct Stage *stages[] = {&computeStage, &colorStage, &encodeStage, &writeStage};
+  void* (*runs[])(void*) = {ComputeStage, ColorStage, EncodeStage, WriteStage};
+  int threads[] = {COMPUTE_THREADS, COLOR_THREADS, ENCODE_THREADS, 1};
+  const char *names[] = {"compute", "color", "encode", "write"};
+  struct Ring *rings[] = {NULL, &computed, &colored, &encoded, NULL};
+  size_t frameBytes = sizeof(float) * WIDTH * HEIGHT;
+  //Worst case is "255.000000, " for every pixel
+  size_t textBytes = (size_t)WIDTH * HEIGHT * 12 + 16;
+  pthread_t *handles[4];
+  struct Stage *limit = NULL;
+  double wall = Seconds();
+  int nodes = NumaTopology(&numaNodes);
+
+  //Every node in use needs at least one compute thread and one slot
+  slotNodes = NUMA ? nodes : 1;
+  if(slotNodes > COMPUTE_THREADS) slotNodes = COMPUTE_THREADS;
+  if(slotNodes > FRAMES_IN_FLIGHT) slotNodes = FRAMES_IN_FLIGHT;
+  printf("%d NUMA node(s), using %d\n", nodes, slotNodes);
+
+  //Room for every slot plus one stop signal per thread of the next stage
+  freeRings = malloc(sizeof(struct Ring) * slotNodes);
+  for(int n = 0; n < slotNodes; n++){
+    RingInit(&freeRings[n], FRAMES_IN_FLIGHT);
+  }
+  RingInit(&computed, FRAMES_IN_FLIGHT + COLOR_THREADS);
+  RingInit(&colored, FRAMES_IN_FLIGHT + ENCODE_THREADS);
+  RingInit(&encoded, FRAMES_IN_FLIGHT + 1);
+
+  //Nothing touches the buffers yet, so their pages end up on whichever node first writes to them
+  slots = malloc(sizeof(struct PipelineSlot) * FRAMES_IN_FLIGHT);
+  for(int i = 0; i < FRAMES_IN_FLIGHT; i++){
+    slots[i].node = i % slotNodes;
+    slots[i].touched = 0;
+    slots[i].values = FrameAlloc(frameBytes);
+    slots[i].histogram = malloc(sizeof(float) * MAX_I);
+    slots[i].nums = FrameAlloc(frameBytes);
+    slots[i].text = ARCHIVE ? NULL : FrameAlloc(textBytes);
+    RingPush(&freeRings[slots[i].node], i);
+  }
+  atomic_store(&nextFrame, 0);
+  atomic_store(&computeWorkers, 0);
+  firstFrame = 0;
+  lastFrame = DIVISIONS;
+  if(SHARD >= 0){
+    if(LoadShard(SHARD, &firstFrame, &lastFrame) != 0){
+      printf("No shard %d in %s, run with ESTIMATE = 1 first\n", SHARD, SHARD_PATH);
+      exit(1);
+    }
+    printf("Shard %d: frames %d to %d\n", SHARD, firstFrame, lastFrame);
+  }
+
+  for(int s = 0; s < 4; s++){
+    stages[s]->name = names[s];
+    stages[s]->threads = threads[s];
+    stages[s]->in = rings[s];
+    stages[s]->out = rings[s + 1];
+    stages[s]->busy = stages[s]->starved = stages[s]->blocked = 0;
+    atomic_store(&stages[s]->alive, threads[s]);
+    pthread_mutex_init(&stages[s]->lock, NULL);
+    handles[s] = malloc(sizeof(pthread_t) * threads[s]);
+    for(int t = 0; t < threads[s]; t++){
+      pthread_create(&handles[s][t], NULL, runs[s], stages[s]);
+    }
+  }
+  for(int s = 0; s < 4; s++){
+    for(int t = 0; t < threads[s]; t++){
+      pthread_join(handles[s][t], NULL);
+    }
+    free(handles[s]);
+  }
+  wall = Seconds() - wall;
+
+  //The stage that was busy the biggest share of the time is the one holding everything else up
+  printf("stage     threads   busy(s)  starved(s)  blocked(s)  utilization\n");
+  for(int s = 0; s < 4; s++){
+    double utilization = stages[s]->busy / (stages[s]->threads * wall);
+    printf("%-9s %7d %9.1f %11.1f %11.1f %11.0f%%\n", stages[s]->name, stages[s]->threads, stages[s]->busy, stages[s]->starved, stages[s]->blocked, 100 * utilization);
+    if(limit == NULL || utilization > limit->busy / (limit->threads * wall)) limit = stages[s];
+    pthread_mutex_destroy(&stages[s]->lock);
+  }
+  printf("Throughput is limited by the %s stage\n", limit->name);
+
+  for(int i = 0; i < FRAMES_IN_FLIGHT; i++){
+    FrameFree(slots[i].values, frameBytes);
+    free(slots[i].histogram);
+    FrameFree(slots[i].nums, frameBytes);
+    if(slots[i].text != NULL) FrameFree(slots[i].text, textBytes);
+  }
+  free(slots);
+  for(int n = 0; n < slotNodes; n++){
+    RingFree(&freeRings[n]);
+  }
+  free(freeRings);
+  NumaFree(numaNodes, nodes);
+  RingFree(&computed);
+  RingFree(&colored);
+  RingFree(&encoded);
+}
+
+//Takes a free slot from its node, claims the next frame and renders it
+void* ComputeStage(void *arg){
+  struct Stage *stage = arg;
+  double busy = 0, starved = 0, blocked = 0;
+  int node = atomic_fetch_add(&computeWorkers, 1) % slotNodes;
+  struct Ring *in = &freeRings[node];
+  int slot;
+
+  if(NUMA) PinThread(&numaNodes[node]);
+
+  for(;;){
+    double t;
+    int frame;
+
+    starved += RingPopWait(in, &slot);
+    frame = atomic_fetch_add(&nextFrame, 1);
+    if(frame > lastFrame - firstFrame){
+      RingPush(in, slot);
+      break;
+    }
+    slots[slot].position = frame;
+    frame = firstFrame + (COARSE_TO_FINE ? FrameOrder(frame, lastFrame - firstFrame) : frame);
+
+    t = Seconds();
+    //First touch from a thread on this node puts all of the slot's pages here
+    if(!slots[slot].touched){
+      memset(slots[slot].values, 0, sizeof(float) * WIDTH * HEIGHT);
+      memset(slots[slot].nums, 0, sizeof(float) * WIDTH * HEIGHT);
+      if(slots[slot].text != NULL) memset(slots[slot].text, 0, (size_t)WIDTH * HEIGHT * 12 + 16);
+      slots[slot].touched = 1;
+    }
+    slots[slot].frame = frame;
+    slots[slot].power = FramePower(frame);
+    for(int i = 0; i < MAX_I; i++){
+      slots[slot].histogram[i] = 0;
+    }
+    RenderFrame(slots[slot].values, slots[slot].histogram, slots[slot].power, 0, 0);
+    busy += Seconds() - t;
+    blocked += RingPushWait(stage->out, slot);
+  }
+
+  StageDone(stage, busy, starved, blocked);
+  return NULL;
+}
+
+void* ColorStage(void *arg){
+  struct Stage *stage = arg;
+  double busy = 0, starved = 0, blocked = 0;
+  int slot;
+
+  for(;;){
+    double t;
+    starved += RingPopWait(stage->in, &slot);
+    if(slot < 0) break;
+
+    t = Seconds();
+    CalculateColors(slots[slot].values, slots[slot].histogram, slots[slot].nums);
+    busy += Seconds() - t;
+    blocked += RingPushWait(stage->out, slot);
+  }
+
+  StageDone(stage, busy, starved, blocked);
+  return NULL;
+}
+
+//Turns the colors into JSON text. The archive stores the floats as they are, so there it does nothing.
+void* EncodeStage(void *arg){
+  struct Stage *stage = arg;
+  double busy = 0, starved = 0, blocked = 0;
+  int slot;
+
+  for(;;){
+    double t;
+    starved += RingPopWait(stage->in, &slot);
+    if(slot < 0) break;
+
+    t = Seconds();
+    if(!ARCHIVE) slots[slot].textLength = EncodeFrame(slots[slot].nums, slots[slot].text);
+    busy += Seconds() - t;
+    blocked += RingPushWait(stage->out, slot);
+  }
+
+  StageDone(stage, busy, starved, blocked);
+  return NULL;
+}
+
+//Writes the frames in order, into the archive or into the same JSON files SweepToJSON() makes
+//(frame 0 and frames 1-100 in the first file, 101-200 in the second, and so on).
+//Frames can finish out of order, but never more than FRAMES_IN_FLIGHT apart, so one waiting
+//spot per slot is enough to put them back in order.
+void* WriteStage(void *arg){
+  struct Stage *stage = arg;
+  double busy = 0, starved = 0, blocked = 0;
+  int *waiting = malloc(sizeof(int) * FRAMES_IN_FLIGHT);
+  int written = 0;
+  int frames = lastFrame - firstFrame;
+  int *remaining = NULL;
+  struct Archive archive;
+  char archivePath[1024];
+  FILE *fp = NULL;
+
+  for(int i = 0; i < FRAMES_IN_FLIGHT; i++){
+    waiting[i] = -1;
+  }
+  //A shard's archive only has the shard's frames, so each one gets its own
+  if(SHARD >= 0){
+    snprintf(archivePath, sizeof(archivePath), "%s.%d", ARCHIVE_PATH, SHARD);
+  }else{
+    snprintf(archivePath, sizeof(archivePath), "%s", ARCHIVE_PATH);
+  }
+  if(ARCHIVE && ArchiveOpen(&archive, archivePath, frames + 1, 0) != 0){
+    printf("Could not open %s\n", archivePath);
+    exit(1);
+  }
+  if(COARSE_TO_FINE){
+    //Frames left to come in for each JSON file
+    remaining = calloc(FrameFile(DIVISIONS) + 1, sizeof(int));
+    for(int i = firstFrame; i <= lastFrame; i++){
+      remaining[FrameFile(i)]++;
+    }
+    if(ARCHIVE && ArchiveReserve(&archive, WIDTH * HEIGHT, FramePower, firstFrame) != 0){
+      printf("Could not write the index of %s\n", archivePath);
+      exit(1);
+    }
+  }
+
+  while(written <= frames){
+    int slot;
+    starved += RingPopWait(stage->in, &slot);
+    waiting[slots[slot].position % FRAMES_IN_FLIGHT] = slot;
+
+    while(written <= frames && waiting[written % FRAMES_IN_FLIGHT] >= 0){
+      double t = Seconds();
+      struct PipelineSlot *frame;
+
+      slot = waiting[written % FRAMES_IN_FLIGHT];
+      waiting[written % FRAMES_IN_FLIGHT] = -1;
+      frame = &slots[slot];
+
+      if(DZI) PublishDzi(frame->nums, frame->frame);
+      if(SHM) PublishShm(frame->values, frame->nums, frame->frame, frame->power);
+      if(COARSE_TO_FINE){
+        if(ARCHIVE){
+          if(ArchivePut(&archive, frame->frame - firstFrame, frame->power, frame->nums, WIDTH * HEIGHT) != 0){
+            printf("Could not write frame %d to %s\n", frame->frame, archivePath);
+            exit(1);
+          }
+        }else{
+          WritePart(frame, remaining);
+        }
+      }else if(ARCHIVE){
+        if(ArchiveAppend(&archive, frame->power, frame->nums, WIDTH * HEIGHT) != 0){
+          printf("Could not write frame %d to %s\n", frame->frame, archivePath);
+          exit(1);
+        }
+      }else{
+        int file = FrameFile(frame->frame);
+        int last = (frame->frame == lastFrame) || (frame->frame == FileLastFrame(file));
+        if(fp == NULL){
+          StartWriteToJSON(file);
+          fp = fopen(GetPath(file), "a");
+        }
+        fwrite(frame->text, 1, frame->textLength, fp);
+        fputs(last ? "\t]\n" : "\t],\n", fp);
+        if(last){
+          fclose(fp);
+          fp = NULL;
+          FinishWriteToJSON(file);
+        }
+      }
+      printf("power: %f, %d/%d iterations, %f%%\n", frame->power, written, frames, (frames > 0) ? (100.0 * written) / frames : 100.0);
+      if(COARSE_TO_FINE && (written == frames || CoarseStep(FrameOrder(written + 1, frames)) != CoarseStep(frame->frame - firstFrame))){
+        printf("All frames %d apart are done\n", CoarseStep(frame->frame - firstFrame));
+      }
+      written++;
+      busy += Seconds() - t;
+      blocked += RingPushWait(&freeRings[frame->node], slot);
+    }
+  }
+
+  if(ARCHIVE && ArchiveClose(&archive) != 0){
+    printf("Could not write %s\n", archivePath);
+    exit(1);
+  }
+  free(remaining);
+  free(waiting);
+  StageDone(stage, busy, starved, blocked);
+  return NULL;
+}
+
+//Keeps a frame's JSON in its own .part file, and once every frame of that file is in, writes the
+//file the normal way with the parts in order
+void WritePart(const struct PipelineSlot *frame, int *remaining){
+  int file = FrameFile(frame->frame);
+  int last = (frame->frame == FileLastFrame(file));
+  int first = FileFirstFrame(file);
+  int end = FileLastFrame(file);
+  char path[1100];
+  char buffer[1 << 16];
+  FILE *fp, *part;
+  size_t n;
+
+  snprintf(path, sizeof(path), "%s.%d.part", GetPath(file), frame->frame);
+  fp = fopen(path, "wb");
+  if(fp == NULL){
+    printf("Could not open %s\n", path);
+    exit(1);
+  }
+  fwrite(frame->text, 1, frame->textLength, fp);
+  fputs(last ? "\t]\n" : "\t],\n", fp);
+  fclose(fp);
+
+  if(--remaining[file] > 0) return;
+
+  StartWriteToJSON(file);
+  fp = fopen(GetPath(file), "a");
+  for(int i = first; i <= end; i++){
+    snprintf(path, sizeof(path), "%s.%d.part", GetPath(file), i);
+    part = fopen(path, "rb");
+    while((n = fread(buffer, 1, sizeof(buffer), part)) > 0){
+      fwrite(buffer, 1, n, fp);
+    }
+    fclose(part);
+    remove(path);
+  }
+  fclose(fp);
+  FinishWriteToJSON(file);
+}
+
+//Adds a thread's times to its stage. The last thread of a stage to finish tells every
+//thread of the next stage to stop (the write stage counts frames instead).
+void StageDone(struct Stage *stage, double busy, double starved, double blocked){
+  pthread_mutex_lock(&stage->lock);
+  stage->busy += busy;
+  stage->starved += starved;
+  stage->blocked += blocked;
+  pthread_mutex_unlock(&stage->lock);
+
+  if(atomic_fetch_sub(&stage->alive, 1) == 1){
+    struct Stage *next = (stage == &computeStage) ? &colorStage : (stage == &colorStage) ? &encodeStage : NULL;
+    if(next == NULL) return;
+    for(int i = 0; i < next->threads; i++){
+      RingPushWait(stage->out, -1);
+    }
+  }
+}
+
+//Same text MiddleWriteToJSON() writes for a frame, minus the closing bracket
+size_t EncodeFrame(const float *arr, char *text){
+  char *p = text;
+
+  p += sprintf(p, "\t\t[");
+  for(int i = 0; i < WIDTH * HEIGHT; i++){
+    if(arr[i] == arr[i]){
+      p += sprintf(p, "%f", arr[i]);
+    }else{
+      p += sprintf(p, "NaN");
+    }
+    if(i < WIDTH * HEIGHT - 1) p += sprintf(p, ", ");
+  }
+  return p - text;
+}
+
+//capacity gets rounded up to a power of 2
+void RingInit(struct Ring *ring, int capacity){
+  size_t size = 1;
+  while(size < (size_t)capacity) size *= 2;
+
+  ring->cells = malloc(sizeof(struct RingCell) * size);
+  ring->mask = size - 1;
+  for(size_t i = 0; i < size; i++){
+    atomic_init(&ring->cells[i].sequence, i);
+  }
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+}
+
+void RingFree(struct Ring *ring){
+  free(ring->cells);
+  ring->cells = NULL;
+}
+
+//Returns -1 if the ring is full
+int RingPush(struct Ring *ring, int value){
+  size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  for(;;){
+    struct RingCell *cell = &ring->cells[pos & ring->mask];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if(diff == 0){
+      if(atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)){
+        cell->value = value;
+        atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+        return 0;
+      }
+    }else if(diff < 0){
+      return -1;
+    }else{
+      pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    }
+  }
+}
+
+//Returns -1 if the ring is empty
+int RingPop(struct Ring *ring, int *value){
+  size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  for(;;){
+    struct RingCell *cell = &ring->cells[pos & ring->mask];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+    if(diff == 0){
+      if(atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)){
+        *value = cell->value;
+        atomic_store_explicit(&cell->sequence, pos + ring->mask + 1, memory_order_release);
+        return 0;
+      }
+    }else if(diff < 0){
+      return -1;
+    }else{
+      pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+  }
+}
+
+//The waiting versions keep retrying until they get through and return how long that took.
+//They yield for a while first, then sleep so a stalled stage doesn't eat a whole core.
+double RingPushWait(struct Ring *ring, int value){
+  double t;
+  if(RingPush(ring, value) == 0) return 0;
+  t = Seconds();
+  for(int tries = 0; RingPush(ring, value) != 0; tries++){
+    if(tries < 64) sched_yield();
+    else usleep(100);
+  }
+  return Seconds() - t;
+}
+
+double RingPopWait(struct Ring *ring, int *value){
+  double t;
+  if(RingPop(ring, value) == 0) return 0;
+  t = Seconds();
+  for(int tries = 0; RingPop(ring, value) != 0; tries++){
+    if(tries < 64) sched_yield();
+    else usleep(100);
+  }
+  return Seconds() - t;
+}
+
+//Reads the NUMA layout from sysfs. Anywhere that doesn't have it (or isn't Linux)
+//gets a single node with every CPU on it. Returns the number of nodes.
+int NumaTopology(struct NumaNode **nodes){
+  int count = 0;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if(cpus < 1) cpus = 1;
+  *nodes = NULL;
+#ifdef __linux__
+  for(int index = 0; ; index++){
+    char path[128];
+    char list[4096];
+    char *p = list;
+    FILE *fp;
+    struct NumaNode node = {malloc(sizeof(int) * cpus), 0};
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", index);
+    fp = fopen(path, "r");
+    if(fp == NULL){
+      free(node.cpus);
+      break;
+    }
+    if(fgets(list, sizeof(list), fp) == NULL) list[0] = '\0';
+    fclose(fp);
+
+    //The list looks like 0-15,32-47
+    while(*p != '\0' && *p != '\n'){
+      char *end;
+      long first = strtol(p, &end, 10), last = first;
+      if(end == p) break;
+      if(*end == '-') last = strtol(end + 1, &end, 10);
+      for(long c = first; c <= last && node.count < cpus; c++){
+        node.cpus[node.count++] = c;
+      }
+      p = (*end == ',') ? end + 1 : end;
+    }
+
+    //Memory only nodes don't have any CPUs to run on
+    if(node.count == 0){
+      free(node.cpus);
+      continue;
+    }
+    *nodes = realloc(*nodes, sizeof(struct NumaNode) * (count + 1));
+    (*nodes)[count++] = node;
+  }
+#endif
+
+  if(count == 0){
+    *nodes = malloc(sizeof(struct NumaNode));
+    (*nodes)[0].cpus = malloc(sizeof(int) * cpus);
+    (*nodes)[0].count = cpus;
+    for(long c = 0; c < cpus; c++){
+      (*nodes)[0].cpus[c] = c;
+    }
+    count = 1;
+  }
+  return count;
+}
+
+void NumaFree(struct NumaNode *nodes, int count){
+  for(int i = 0; i < count; i++){
+    free(nodes[i].cpus);
+  }
+  free(nodes);
+}
+
+//Lets the calling thread run on any CPU of the node, but nowhere else
+void PinThread(const struct NumaNode *node){
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for(int i = 0; i < node->count; i++){
+    CPU_SET(node->cpus[i], &set);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)node;
+#endif
+}
+
+//Page aligned, untouched memory for a frame buffer. With HUGE_PAGES the size is rounded up to
+//whole 2MB pages and it tries explicit huge pages first, then asks for transparent ones, so an
+//8K frame needs a handful of TLB entries instead of thousands.
+void* FrameAlloc(size_t bytes){
+  size_t huge = 2 * 1024 * 1024;
+  void *buffer = MAP_FAILED;
+
+  if(HUGE_PAGES) bytes = (bytes + huge - 1) / huge * huge;
+#ifdef MAP_HUGETLB
+  if(HUGE_PAGES) buffer = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if(buffer == MAP_FAILED){
+    buffer = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(buffer == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    if(HUGE_PAGES) madvise(buffer, bytes, MADV_HUGEPAGE);
+#endif
+  }
+  return buffer;
+}
+
+//bytes has to be the same size that was passed to FrameAlloc()
+void FrameFree(void *buffer, size_t bytes){
+  size_t huge = 2 * 1024 * 1024;
+
+  if(buffer == NULL) return;
+  if(HUGE_PAGES) bytes = (bytes + huge - 1) / huge * huge;
+  munmap(buffer, bytes);
+}
+
+//Powers and windows picked to cover negative, fractional, integer and large powers, plus a few zoomed in boundaries
+struct AccuracyCase accuracyCorpus[] = {
+  {-3.5, 0, 0, 3.5}, {-2, 0, 0, 3.5}, {-1, 0, 0, 3.5}, {-0.5, 0, 0, 3.5},
+  {0.5, 0, 0, 3.5}, {1.5, 0, 0, 3.5}, {2, 0, 0, 3.5}, {2.5, 0, 0, 3.5},
+  {3, 0, 0, 3.5}, {4, 0, 0, 3.5}, {7.25, 0, 0, 3.5}, {10, 0, 0, 3.5},
+  {2, -0.75, 0.1, 0.05}, {2, -1.25, 0, 0.1}, {3, 0.3, 0.5, 0.2}, {-2, 0.5, 0.5, 0.5}
+};
+
+//Renders every frame of the corpus with both kernels and compares them pixel by pixel.
+//Each case is checked at frames frames of the sweep in a row starting at its power, for kernels
+//that share work between frames (1 for the rest), and its worst frame is printed.
+//Returns the number of frames that went over a tolerance.
+int AccuracyCheck(FrameKernel reference, FrameKernel candidate, int frames){
+  int cases = sizeof(accuracyCorpus) / sizeof(accuracyCorpus[0]);
+  int pixels = ACCURACY_SIZE * ACCURACY_SIZE;
+  float *expected = malloc(sizeof(float) * pixels);
+  float *actual = malloc(sizeof(float) * pixels);
+  float histogramA[MAX_I], histogramB[MAX_I];
+  float huesA[MAX_I], huesB[MAX_I];
+  int failures = 0;
+
+  printf("   power   center_x   center_y    range  mismatched  max_escape_diff  max_hue_error\n");
+  for(int c = 0; c < cases; c++){
+    struct AccuracyCase *test = &accuracyCorpus[c];
+    int first = FrameIndex(test->power);
+    int mismatched = 0, failed = 0;
+    float maxDiff = 0, maxHue = 0;
+
+    for(int f = 0; f < frames; f++){
+      //Powers past the end of the sweep (or a case that isn't a frame of it) just keep going INCREMENT apart
+      float power = (first >= 0 && first + f <= DIVISIONS) ? FramePower(first + f) : test->power + f * INCREMENT;
+      int frameMismatched = 0;
+      float frameDiff = 0, frameHue = 0;
+
+      reference(expected, ACCURACY_SIZE, test->centerX, test->centerY, test->range, power, 0, 0, MAX_I);
+      candidate(actual, ACCURACY_SIZE, test->centerX, test->centerY, test->range, power, 0, 0, MAX_I);
+
+      for(int i = 0; i < MAX_I; i++){
+        histogramA[i] = histogramB[i] = 0;
+      }
+      for(int i = 0; i < pixels; i++){
+        if(expected[i] < MAX_I) histogramA[(int)expected[i]]++;
+        if(actual[i] < MAX_I) histogramB[(int)actual[i]]++;
+      }
+      Hues(histogramA, huesA, MAX_I);
+      Hues(histogramB, huesB, MAX_I);
+
+      for(int i = 0; i < pixels; i++){
+        float diff = fabs(expected[i] - actual[i]);
+        int inA = expected[i] >= MAX_I, inB = actual[i] >= MAX_I;
+        float hue;
+
+        if(diff > 0) frameMismatched++;
+        if(diff > frameDiff) frameDiff = diff;
+        if(inA != inB){
+          hue = 255;
+        }else if(inA){
+          hue = 0;
+        }else{
+          hue = 255 * fabs(huesA[(int)expected[i]] - huesB[(int)actual[i]]);
+        }
+        if(hue > frameHue) frameHue = hue;
+      }
+
+      failed += frameMismatched > ACCURACY_MAX_MISMATCH * pixels || frameDiff > ACCURACY_MAX_ESCAPE_DIFF || frameHue > ACCURACY_MAX_HUE_ERROR;
+      if(frameMismatched > mismatched) mismatched = frameMismatched;
+      if(frameDiff > maxDiff) maxDiff = frameDiff;
+      if(frameHue > maxHue) maxHue = frameHue;
+    }
+
+    failures += failed;
+    printf("%8.3f %10.4f %10.4f %8.4f %11d %16.0f %14.2f  %s\n", test->power, test->centerX, test->centerY, test->range, mismatched, maxDiff, maxHue, failed ? "FAIL" : "ok");
+  }
+
+  printf("%d/%d frames within tolerance\n", cases * frames - failures, cases * frames);
+  free(expected);
+  free(actual);
+  return failures;
+}
+
+//BAILOUT's check: every pixel of the corpus has to be in the set with the power's own escape radius
+//exactly when it is with radius 4. The escape counts are allowed to differ, that's the point of it.
+//A pixel one radius sees escape just before MAX_I can still be inside for the other one when it hits MAX_I
+//first, so those get iterated on (up to 16 * MAX_I) with the other radius: if they escape there too it was
+//only the cap (at_cap, printed but fine), if not the radii really disagree.
+//Returns the number of cases where any pixel really disagrees.
+int BailoutCheck(){
+  int cases = sizeof(accuracyCorpus) / sizeof(accuracyCorpus[0]);
+  int failures = 0;
+
+  printf("   power   center_x   center_y    range  disagreeing  at_cap  iterations_saved\n");
+  for(int c = 0; c < cases; c++){
+    struct AccuracyCase *test = &accuracyCorpus[c];
+    int disagreeing = 0, atCap = 0;
+    double saved = 0, total = 0;
+
+    for(int i = 0; i < ACCURACY_SIZE; i++){
+      for(int j = 0; j < ACCURACY_SIZE; j++){
+        float re = test->centerX - test->range / 2 + i * test->range / ACCURACY_SIZE;
+        float im = test->centerY - test->range / 2 + j * test->range / ACCURACY_SIZE;
+        float radius = MandelbrotBailout(re, im, test->power, 0, 0);
+        float fixedRe = re, fixedIm = im, ownRe = re, ownIm = im;
+        int fixed = MandelbrotResume(re, im, test->power, 0, 0, MAX_I, &fixedRe, &fixedIm, 0);
+        int own = MandelbrotResumeWithin(re, im, test->power, 0, 0, MAX_I, &ownRe, &ownIm, 0, radius);
+
+        saved += fixed - own;
+        total += fixed;
+        if((fixed >= MAX_I) == (own >= MAX_I)) continue;
+        if(fixed >= MAX_I){
+          fixed = MandelbrotResume(re, im, test->power, 0, 0, 16 * MAX_I, &fixedRe, &fixedIm, fixed);
+          if(fixed < 16 * MAX_I) atCap++; else disagreeing++;
+        }else{
+          own = MandelbrotResumeWithin(re, im, test->power, 0, 0, 16 * MAX_I, &ownRe, &ownIm, own, radius);
+          if(own < 16 * MAX_I) atCap++; else disagreeing++;
+        }
+      }
+    }
+
+    failures += disagreeing > 0;
+    printf("%8.3f %10.4f %10.4f %8.4f %12d %7d %16.1f%%  %s\n", test->power, test->centerX, test->centerY, test->range, disagreeing,
+      atCap, (total > 0) ? 100 * saved / total : 0, disagreeing ? "FAIL" : "ok");
+  }
+
+  printf("%d/%d cases agree on the set\n", cases - failures, cases);
+  return failures;
+}
+
+//The reference the fast kernels get checked against. Keep it exactly like the original loop.
+void ReferenceKernel(float *values, int size, float centerX, float centerY, float range, float power, float cR, float cI, int maxI){
+  for(int i = 0; i < size; i++){
+    for(int j = 0; j < size; j++){
+      float re = centerX - range / 2 + i * range / size;
+      float im = centerY - range / 2 + j * range / size;
+      values[i * size + j] = EscapeReference(re, im, power, cR, cI, maxI);
+    }
+  }
+}
+
+//The kernel the sweeps actually use
+void EscapeKernel(float *values, int size, float centerX, float centerY, float range, float power, float cR, float cI, int maxI){
+  for(int i = 0; i < size; i++){
+    for(int j = 0; j < size; j++){
+      float re = centerX - range / 2 + i * range / size;
+      float im = centerY - range / 2 + j * range / size;
+      values[i * size + j] = Escape(re, im, power, cR, cI, maxI);
+    }
+  }
+}
+
+//The kernel CERTIFY uses: a pixel gets the count certified for the whole CERTIFY_BLOCK frame block of the sweep
+//the power is in, and is only iterated at power if that fails. A power that isn't a frame of the sweep gets
+//a block of its own, CERTIFY_BLOCK frames INCREMENT apart from it on.
+void CertifiedKernel(float *values, int size, float centerX, float centerY, float range, float power, float cR, float cI, int maxI){
+  int frame = FrameIndex(power);
+  float powerLo = power, powerHi = power + (CERTIFY_BLOCK - 1) * INCREMENT;
+
+  if(frame >= 0) BlockPowers(frame / CERTIFY_BLOCK, &powerLo, &powerHi);
+  for(int i = 0; i < size; i++){
+    for(int j = 0; j < size; j++){
+      float re = centerX - range / 2 + i * range / size;
+      float im = centerY - range / 2 + j * range / size;
+      int n = MandelbrotCertify(re, im, powerLo, powerHi, cR, cI, maxI);
+      values[i * size + j] = (n >= 0) ? n : Escape(re, im, power, cR, cI, maxI);
+    }
+  }
+}
+
+//The escape loop as it was written originally, don't speed this one up
+int EscapeReference(float re, float im, float power, float cR, float cI, int maxI){
+  struct Complex com1 = {re, im};
+  struct Complex com2 = {re, im};
+  int n = 0;
+
+  while(n < maxI && sqrt(com1.re * com1.re + com1.im * com1.im) < 4) {
+    com1 = Alg(com1, com2, power, cR, cI);
+    n++;
+  }
+  return n;
+}
+
+//Renders a frame far too big for memory. The histogram coloring needs every pixel before it
+//can color any of them, so it takes two passes over the tiles:
+//  1. render each tile, write its escape counts to the counts file, add it to the global histogram
+//  2. read each tile's counts back, color it with the global hues, write it into the TIFF
+//Tiles in memory at once never go over POSTER_THREADS.
+void RenderPoster(){
+  struct Poster poster;
+  pthread_t *threads = malloc(sizeof(pthread_t) * POSTER_THREADS);
+  double total = 0, h = 0;
+
+  if(MAX_I > 65535){
+    printf("The poster stores escape counts in 16 bits, MAX_I has to be 65535 or less\n");
+    free(threads);
+    return;
+  }
+
+  poster.tilesX = (POSTER_WIDTH + POSTER_TILE - 1) / POSTER_TILE;
+  poster.tilesY = (POSTER_HEIGHT + POSTER_TILE - 1) / POSTER_TILE;
+  poster.histogram = calloc(MAX_I, sizeof(uint64_t));
+  poster.hues = malloc(sizeof(float) * MAX_I);
+  //Tiles go right after the 16 byte BigTIFF header, the IFD goes after the tiles
+  poster.dataStart = 16;
+  pthread_mutex_init(&poster.lock, NULL);
+
+  poster.countsFd = open(POSTER_COUNTS_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  poster.tiffFd = open(POSTER_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(poster.countsFd < 0 || poster.tiffFd < 0){
+    printf("Could not open %s or %s\n", POSTER_COUNTS_PATH, POSTER_PATH);
+    if(poster.countsFd >= 0) close(poster.countsFd);
+    if(poster.tiffFd >= 0) close(poster.tiffFd);
+    free(poster.histogram);
+    free(poster.hues);
+    free(threads);
+    return;
+  }
+
+  for(poster.pass = 1; poster.pass <= 2; poster.pass++){
+    atomic_store(&poster.nextTile, 0);
+    for(int t = 0; t < POSTER_THREADS; t++){
+      pthread_create(&threads[t], NULL, PosterWorker, &poster);
+    }
+    for(int t = 0; t < POSTER_THREADS; t++){
+      pthread_join(threads[t], NULL);
+    }
+
+    //Same as Hues(), but in 64 bits since a poster has billions of pixels
+    if(poster.pass == 1){
+      for(int i = 0; i < MAX_I; i++){
+        total += poster.histogram[i];
+      }
+      for(int i = 0; i < MAX_I; i++){
+        h += (total > 0) ? poster.histogram[i] / total : 0;
+        poster.hues[i] = h;
+      }
+      printf("Pass 1 done, %.0f of %ld pixels escaped\n", total, POSTER_WIDTH * POSTER_HEIGHT);
+    }
+  }
+
+  WritePosterIFD(&poster);
+  close(poster.countsFd);
+  close(poster.tiffFd);
+  unlink(POSTER_COUNTS_PATH);
+  pthread_mutex_destroy(&poster.lock);
+  free(poster.histogram);
+  free(poster.hues);
+  free(threads);
+}
+
+void* PosterWorker(void *arg){
+  struct Poster *poster = arg;
+  long tiles = poster->tilesX * poster->tilesY;
+  size_t pixels = (size_t)POSTER_TILE * POSTER_TILE;
+  uint16_t *counts = malloc(sizeof(uint16_t) * pixels);
+  unsigned char *rgb = malloc(3 * pixels);
+  uint64_t *histogram = calloc(MAX_I, sizeof(uint64_t));
+
+  for(long tile = atomic_fetch_add(&poster->nextTile, 1); tile < tiles; tile = atomic_fetch_add(&poster->nextTile, 1)){
+    long tileX = tile % poster->tilesX, tileY = tile / poster->tilesX;
+
+    if(poster->pass == 1){
+      //Tiles are stored row by row like the TIFF. Pixels past the edge of the poster just get padded.
+      for(int y = 0; y < POSTER_TILE; y++){
+        for(int x = 0; x < POSTER_TILE; x++){
+          long px = tileX * POSTER_TILE + x, py = tileY * POSTER_TILE + y;
+          int n = MAX_I;
+          if(px < POSTER_WIDTH && py < POSTER_HEIGHT){
+            float re = MIN_X + (px * (double)RANGE_X) / POSTER_WIDTH;
+            float im = MIN_Y + (py * (double)RANGE_Y) / POSTER_HEIGHT;
+            n = Escape(re, im, POSTER_POWER, 0, 0, MAX_I);
+            if(n < MAX_I) histogram[n]++;
+          }
+          counts[y * POSTER_TILE + x] = n;
+        }
+      }
+      //A short write here would come back as garbage counts in pass 2, so the poster stops instead
+      if(pwrite(poster->countsFd, counts, sizeof(uint16_t) * pixels, (off_t)tile * sizeof(uint16_t) * pixels) != (ssize_t)(sizeof(uint16_t) * pixels)){
+        printf("Could not write tile %ld to %s\n", tile, POSTER_COUNTS_PATH);
+        exit(1);
+      }
+    }else{
+      if(pread(poster->countsFd, counts, sizeof(uint16_t) * pixels, (off_t)tile * sizeof(uint16_t) * pixels) != (ssize_t)(sizeof(uint16_t) * pixels)){
+        printf("Could not read tile %ld back from %s\n", tile, POSTER_COUNTS_PATH);
+        exit(1);
+      }
+      for(size_t i = 0; i < pixels; i++){
+        HueToRGB((counts[i] >= MAX_I) ? NAN : 255 - 255 * poster->hues[counts[i]], &rgb[3 * i]);
+      }
+      if(pwrite(poster->tiffFd, rgb, 3 * pixels, poster->dataStart + (off_t)tile * 3 * pixels) != (ssize_t)(3 * pixels)){
+        printf("Could not write tile %ld to %s\n", tile, POSTER_PATH);
+        exit(1);
+      }
+    }
+
+    if(tile % 64 == 0) printf("pass %d: tile %ld/%ld\n", poster->pass, tile, tiles);
+  }
+
+  pthread_mutex_lock(&poster->lock);
+  for(int i = 0; i < MAX_I; i++){
+    poster->histogram[i] += histogram[i];
+  }
+  pthread_mutex_unlock(&poster->lock);
+
+  free(counts);
+  free(rgb);
+  free(histogram);
+  return NULL;
+}
+
+//Writes the BigTIFF header and the one IFD that describes the tiles (8 bit RGB, no compression).
+//Numbers are written in the machine's byte order, which is little endian ("II") everywhere we render.
+void WritePosterIFD(struct Poster *poster){
+  long tiles = poster->tilesX * poster->tilesY;
+  uint64_t tileBytes = 3 * (uint64_t)POSTER_TILE * POSTER_TILE;
+  uint64_t ifd = poster->dataStart + tiles * tileBytes;
+  uint64_t offsets = ifd + 8 + 11 * 20 + 8;
+  uint64_t counts = offsets + 8 * tiles;
+  //tag, type (3 = short, 4 = long, 16 = 64 bit long), count, value (or where the values are)
+  uint64_t entries[11][4] = {
+    {256, 4, 1, POSTER_WIDTH},
+    {257, 4, 1, POSTER_HEIGHT},
+    {258, 3, 3, 8 | (8ull << 16) | (8ull << 32)},
+    {259, 3, 1, 1},
+    {262, 3, 1, 2},
+    {277, 3, 1, 3},
+    {284, 3, 1, 1},
+    {322, 4, 1, POSTER_TILE},
+    {323, 4, 1, POSTER_TILE},
+    {324, 16, tiles, offsets},
+    {325, 16, tiles, counts}
+  };
+  unsigned char header[16] = {'I', 'I', 43, 0, 8, 0, 0, 0};
+  uint64_t number = 11, next = 0;
+  int failed;
+  FILE *fp = fdopen(dup(poster->tiffFd), "r+b");
+
+  if(fp == NULL){
+    printf("Could not write the header of %s\n", POSTER_PATH);
+    exit(1);
+  }
+  memcpy(&header[8], &ifd, 8);
+  fwrite(header, 1, 16, fp);
+
+  failed = fseek(fp, ifd, SEEK_SET) != 0;
+  fwrite(&number, 8, 1, fp);
+  for(int i = 0; i < 11; i++){
+    uint16_t tag = entries[i][0], type = entries[i][1];
+    fwrite(&tag, 2, 1, fp);
+    fwrite(&type, 2, 1, fp);
+    fwrite(&entries[i][2], 8, 1, fp);
+    fwrite(&entries[i][3], 8, 1, fp);
+  }
+  fwrite(&next, 8, 1, fp);
+
+  for(long i = 0; i < tiles; i++){
+    uint64_t offset = poster->dataStart + i * tileBytes;
+    fwrite(&offset, 8, 1, fp);
+  }
+  for(long i = 0; i < tiles; i++){
+    fwrite(&tileBytes, 8, 1, fp);
+  }
+  //Any failed write sets the error flag, so checking once at the end catches all of them
+  failed |= ferror(fp);
+  if(fclose(fp) != 0 || failed){
+    printf("Could not write the header of %s\n", POSTER_PATH);
+    exit(1);
+  }
+}
+
+//Same color the Java visualizer draws: hue out of 255 at full saturation and brightness, black for NaN
+void HueToRGB(float hue, unsigned char *rgb){
+  float h, f;
+  unsigned char rise, fall;
+
+  if(hue != hue){
+    rgb[0] = rgb[1] = rgb[2] = 0;
+    return;
+  }
+  h = fmod(hue / 255.0 * 6, 6);
+  if(h < 0) h += 6;
+  f = h - (int)h;
+  rise = (unsigned char)(255 * f + 0.5);
+  fall = 255 - rise;
+  switch((int)h){
+    case 0: rgb[0] = 255; rgb[1] = rise; rgb[2] = 0; break;
+    case 1: rgb[0] = fall; rgb[1] = 255; rgb[2] = 0; break;
+    case 2: rgb[0] = 0; rgb[1] = 255; rgb[2] = rise; break;
+    case 3: rgb[0] = 0; rgb[1] = fall; rgb[2] = 255; break;
+    case 4: rgb[0] = rise; rgb[1] = 0; rgb[2] = 255; break;
+    default: rgb[0] = 255; rgb[1] = 0; rgb[2] = fall; break;
+  }
+}
+
+pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+//Bytes in the cache directory, -1 until it has been counted
+long long cacheBytes = -1;
+
+void MakeFrameKey(struct FrameKey *key, float power, float cR, float cI){
+  memset(key, 0, sizeof(struct FrameKey));
+  key->version = KERNEL_VERSION;
+  key->power = power;
+  key->cR = cR;
+  key->cI = cI;
+  key->minX = MIN_X;
+  key->maxX = MAX_X;
+  key->minY = MIN_Y;
+  key->maxY = MAX_Y;
+  key->width = WIDTH;
+  key->height = HEIGHT;
+  key->maxI = MAX_I;
+  key->aaGrid = ANTIALIAS ? AA_GRID : 0;
+  key->aaBudget = ANTIALIAS ? AA_BUDGET : 0;
+  key->adaptiveMinI = ADAPTIVE ? ADAPTIVE_MIN_I : 0;
+  key->adaptiveStep = ADAPTIVE ? ADAPTIVE_STEP : 0;
+  key->adaptiveQuality = ADAPTIVE ? ADAPTIVE_QUALITY : 0;
+  key->bailout = BAILOUT;
+}
+
+void CachePath(const struct FrameKey *key, char *path, size_t size){
+  snprintf(path, size, "%s/%016llx.frame", FRAME_CACHE_DIR, (unsigned long long)Hash64(key, sizeof(struct FrameKey)));
+}
+
+//Returns 1 and fills values and histogram if the frame is cached. A file is the key, then the histogram, then the values.
+int CacheLoad(const struct FrameKey *key, float *values, float *histogram){
+  char path[1024];
+  struct FrameKey stored;
+  FILE *fp;
+  int found;
+
+  CachePath(key, path, sizeof(path));
+  fp = fopen(path, "rb");
+  if(fp == NULL) return 0;
+
+  found = fread(&stored, sizeof(stored), 1, fp) == 1 && memcmp(&stored, key, sizeof(stored)) == 0
+    && fread(histogram, sizeof(float), MAX_I, fp) == (size_t)MAX_I
+    && fread(values, sizeof(float), (size_t)WIDTH * HEIGHT, fp) == (size_t)WIDTH * HEIGHT;
+  //Touching the file marks it as recently used for CacheEvict()
+  if(found) futimens(fileno(fp), NULL);
+  fclose(fp);
+  return found;
+}
+
+//Writes to a temporary name and renames it into place, so other threads (or runs) never see half a frame
+void CacheStore(const struct FrameKey *key, const float *values, const float *histogram){
+  char path[1024], temp[1100];
+  long long bytes = sizeof(struct FrameKey) + sizeof(float) * (MAX_I + (long long)WIDTH * HEIGHT);
+  FILE *fp;
+  int ok;
+
+  mkdir(FRAME_CACHE_DIR, 0755);
+  CachePath(key, path, sizeof(path));
+  snprintf(temp, sizeof(temp), "%s.%d.%lu.tmp", path, (int)getpid(), (unsigned long)pthread_self());
+  fp = fopen(temp, "wb");
+  if(fp == NULL) return;
+
+  ok = fwrite(key, sizeof(struct FrameKey), 1, fp) == 1
+    && fwrite(histogram, sizeof(float), MAX_I, fp) == (size_t)MAX_I
+    && fwrite(values, sizeof(float), (size_t)WIDTH * HEIGHT, fp) == (size_t)WIDTH * HEIGHT;
+  ok = (fclose(fp) == 0) && ok;
+  if(!ok || rename(temp, path) != 0){
+    unlink(temp);
+    return;
+  }
+
+  pthread_mutex_lock(&cacheLock);
+  if(cacheBytes >= 0) cacheBytes += bytes;
+  if(cacheBytes < 0 || cacheBytes > FRAME_CACHE_BYTES) CacheEvict();
+  pthread_mutex_unlock(&cacheLock);
+}
+
+struct CacheFile{
+  char name[64];
+  time_t used;
+  long long bytes;
+};
+
+int CompareCacheFile(const void *a, const void *b){
+  time_t ua = ((const struct CacheFile*)a)->used, ub = ((const struct CacheFile*)b)->used;
+  return (ua > ub) - (ua < ub);
+}
+
+//Counts up the cache and, if it is over FRAME_CACHE_BYTES, deletes the least recently used
+//frames until it is down to 90% of it (so it doesn't have to do this again on the very next frame).
+//Must be called with cacheLock held.
+void CacheEvict(){
+  DIR *dir = opendir(FRAME_CACHE_DIR);
+  struct dirent *entry;
+  struct CacheFile *files = NULL;
+  int count = 0, capacity = 0;
+  char path[1024];
+  struct stat st;
+
+  if(dir == NULL) return;
+  cacheBytes = 0;
+  while((entry = readdir(dir)) != NULL){
+    size_t length = strlen(entry->d_name);
+    if(length < 6 || length >= sizeof(files[0].name) || strcmp(entry->d_name + length - 6, ".frame") != 0) continue;
+    snprintf(path, sizeof(path), "%s/%s", FRAME_CACHE_DIR, entry->d_name);
+    if(stat(path, &st) != 0) continue;
+
+    if(count == capacity){
+      capacity = capacity ? 2 * capacity : 256;
+      files = realloc(files, sizeof(struct CacheFile) * capacity);
+    }
+    strcpy(files[count].name, entry->d_name);
+    files[count].used = st.st_mtime;
+    files[count].bytes = st.st_size;
+    cacheBytes += st.st_size;
+    count++;
+  }
+  closedir(dir);
+
+  if(cacheBytes > FRAME_CACHE_BYTES){
+    qsort(files, count, sizeof(struct CacheFile), CompareCacheFile);
+    for(int i = 0; i < count && cacheBytes > FRAME_CACHE_BYTES / 10 * 9; i++){
+      snprintf(path, sizeof(path), "%s/%s", FRAME_CACHE_DIR, files[i].name);
+      if(unlink(path) == 0) cacheBytes -= files[i].bytes;
+    }
+  }
+  free(files);
+}
+
+//64 bit FNV-1a
+uint64_t Hash64(const void *data, size_t length){
+  const unsigned char *bytes = data;
+  uint64_t hash = 14695981039346656037ull;
+  for(size_t i = 0; i < length; i++){
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+//Renders every (power, cR, cI) of the atlas grid as an ATLAS_CELL sized frame. Thousands of tiny frames
+//would mostly be overhead one at a time, so the threads each take cells off a shared counter and reuse
+//their buffers and the shared coordinates, and the whole sheet is written once at the end.
+void RenderAtlas(){
+  struct Atlas atlas;
+  pthread_t *threads = malloc(sizeof(pthread_t) * ATLAS_THREADS);
+  int rows = ATLAS_C_STEPS * ATLAS_C_STEPS;
+  int sheetHeight = rows * ATLAS_CELL;
+  double start = Seconds();
+  FILE *fp;
+
+  atlas.sheetWidth = ATLAS_POWERS * ATLAS_CELL;
+  atlas.count = ATLAS_POWERS * rows;
+  atlas.cells = calloc(atlas.count, sizeof(struct AtlasCell));
+  atlas.sheet = malloc((size_t)atlas.sheetWidth * sheetHeight * 3);
+  atlas.re = malloc(sizeof(float) * ATLAS_CELL);
+  atlas.im = malloc(sizeof(float) * ATLAS_CELL);
+  atomic_init(&atlas.next, 0);
+
+  for(int i = 0; i < ATLAS_CELL; i++){
+    atlas.re[i] = map(i, 0, ATLAS_CELL, MIN_X, MAX_X);
+    atlas.im[i] = map(i, 0, ATLAS_CELL, MIN_Y, MAX_Y);
+  }
+  for(int k = 0; k < atlas.count; k++){
+    int column = k % ATLAS_POWERS, row = k / ATLAS_POWERS;
+    atlas.cells[k].power = (ATLAS_POWERS > 1) ? ATLAS_POWER_START + column * (ATLAS_POWER_END - ATLAS_POWER_START) / (ATLAS_POWERS - 1) : ATLAS_POWER_START;
+    atlas.cells[k].cR = (ATLAS_C_STEPS > 1) ? ATLAS_C_MIN + (row % ATLAS_C_STEPS) * (ATLAS_C_MAX - ATLAS_C_MIN) / (ATLAS_C_STEPS - 1) : ATLAS_C_MIN;
+    atlas.cells[k].cI = (ATLAS_C_STEPS > 1) ? ATLAS_C_MIN + (row / ATLAS_C_STEPS) * (ATLAS_C_MAX - ATLAS_C_MIN) / (ATLAS_C_STEPS - 1) : ATLAS_C_MIN;
+  }
+
+  for(int i = 0; i < ATLAS_THREADS; i++){
+    pthread_create(&threads[i], NULL, AtlasWorker, &atlas);
+  }
+  for(int i = 0; i < ATLAS_THREADS; i++){
+    pthread_join(threads[i], NULL);
+  }
+  printf("atlas: %d cells of %dx%d in %.2fs\n", atlas.count, ATLAS_CELL, ATLAS_CELL, Seconds() - start);
+
+  if(WritePNG(ATLAS_PATH, atlas.sheet, atlas.sheetWidth * 3, atlas.sheetWidth, sheetHeight) != 0){
+    printf("Could not write %s\n", ATLAS_PATH);
+  }
+  fp = fopen(ATLAS_STATS_PATH, "w");
+  if(fp != NULL){
+    fprintf(fp, "power,cR,cI,inside,boundary,mean_escape,max_escape\n");
+    for(int k = 0; k < atlas.count; k++){
+      struct AtlasCell *cell = &atlas.cells[k];
+      fprintf(fp, "%f,%f,%f,%f,%f,%f,%d\n", cell->power, cell->cR, cell->cI, cell->inside, cell->boundary, cell->meanEscape, cell->maxEscape);
+    }
+    fclose(fp);
+  }else{
+    printf("Could not write %s\n", ATLAS_STATS_PATH);
+  }
+
+  free(threads);
+  free(atlas.cells);
+  free(atlas.sheet);
+  free(atlas.re);
+  free(atlas.im);
+}
+
+void* AtlasWorker(void *arg){
+  struct Atlas *atlas = arg;
+  int pixels = ATLAS_CELL * ATLAS_CELL;
+  float *values = malloc(sizeof(float) * pixels);
+  float *colors = malloc(sizeof(float) * pixels);
+  float *histogram = malloc(sizeof(float) * MAX_I);
+  int k;
+
+  while((k = atomic_fetch_add(&atlas->next, 1)) < atlas->count){
+    struct AtlasCell *cell = &atlas->cells[k];
+    int column = k % ATLAS_POWERS, row = k / ATLAS_POWERS;
+    int inside = 0, boundary = 0, maxEscape = 0;
+    double total = 0;
+
+    memset(histogram, 0, sizeof(float) * MAX_I);
+    for(int i = 0; i < ATLAS_CELL; i++){
+      for(int j = 0; j < ATLAS_CELL; j++){
+        int n = Escape(atlas->re[i], atlas->im[j], cell->power, cell->cR, cell->cI, MAX_I);
+        values[i * ATLAS_CELL + j] = n;
+        if(n < MAX_I){
+          histogram[n]++;
+          total += n;
+          if(n > maxEscape) maxEscape = n;
+        }else{
+          inside++;
+        }
+      }
+    }
+
+    for(int i = 0; i < ATLAS_CELL; i++){
+      for(int j = 0; j < ATLAS_CELL; j++){
+        float n = values[i * ATLAS_CELL + j];
+        if((i > 0 && values[(i - 1) * ATLAS_CELL + j] != n) || (i < ATLAS_CELL - 1 && values[(i + 1) * ATLAS_CELL + j] != n)
+          || (j > 0 && values[i * ATLAS_CELL + j - 1] != n) || (j < ATLAS_CELL - 1 && values[i * ATLAS_CELL + j + 1] != n)) boundary++;
+      }
+    }
+    cell->inside = inside / (float)pixels;
+    cell->boundary = boundary / (float)pixels;
+    cell->meanEscape = (pixels > inside) ? total / (pixels - inside) : 0;
+    cell->maxEscape = maxEscape;
+
+    //Each cell gets colored by its own histogram, like a frame of the sweep
+    if(inside < pixels){
+      MandelbrotColor(values, pixels, histogram, MAX_I, colors);
+    }else{
+      for(int i = 0; i < pixels; i++){
+        colors[i] = NAN;
+      }
+    }
+    for(int i = 0; i < ATLAS_CELL; i++){
+      for(int j = 0; j < ATLAS_CELL; j++){
+        size_t x = (size_t)column * ATLAS_CELL + i, y = (size_t)row * ATLAS_CELL + j;
+        HueToRGB(colors[i * ATLAS_CELL + j], atlas->sheet + (y * atlas->sheetWidth + x) * 3);
+      }
+    }
+  }
+
+  free(values);
+  free(colors);
+  free(histogram);
+  return NULL;
+}
+
+//Finds the thread counts that give this machine the most frames per second and saves them.
+//1. Renders a spread of the sweep's powers (TUNE_SHRINK times smaller) with more and more threads
+//   and keeps the fastest count (a bigger count has to win by 3% to be worth the extra threads).
+//2. Times coloring and encoding a full size frame on one thread.
+//3. Splits the threads between the pipeline stages by how long each stage takes per frame.
+void AutoTune(){
+  struct MandelbrotView view = {CENTER_X, CENTER_Y, RANGE_X, RANGE_Y, WIDTH / TUNE_SHRINK, HEIGHT / TUNE_SHRINK};
+  int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int frames = 4 * 2 * ((cpus > 0) ? cpus : 1);
+  int pixels = view.width * view.height;
+  float *powers = malloc(sizeof(float) * frames);
+  float *values = malloc(sizeof(float) * frames * pixels);
+  float *histograms = malloc(sizeof(float) * frames * MAX_I);
+  float *full = malloc(sizeof(float) * WIDTH * HEIGHT);
+  float *nums = malloc(sizeof(float) * WIDTH * HEIGHT);
+  char *text = malloc((size_t)WIDTH * HEIGHT * 12 + 16);
+  int best = 1;
+  double bestRate = 0, compute, color, encode, total, t;
+  char path[1024];
+  FILE *fp;
+
+  if(cpus < 1) cpus = 1;
+  for(int k = 0; k < frames; k++){
+    powers[k] = FramePower((int)((long)k * DIVISIONS / (frames - 1)));
+  }
+
+  printf("threads  frames/s\n");
+  for(int threads = 1; threads <= 2 * cpus; threads = (threads < cpus && threads * 2 > cpus) ? cpus : threads * 2){
+    double rate;
+    t = Seconds();
+    MandelbrotRenderBatch(&view, powers, frames, 0, 0, MAX_I, values, histograms, threads);
+    rate = frames / (Seconds() - t);
+    printf("%7d  %8.2f\n", threads, rate);
+    if(rate > bestRate * 1.03){
+      best = threads;
+      bestRate = rate;
+    }
+  }
+
+  //Seconds of one thread's time per full size frame for each stage. Coloring and encoding barely
+  //depend on what's in the frame, so one of the small frames blown up to full size is enough.
+  compute = best * ((double)WIDTH * HEIGHT / pixels) / bestRate;
+  for(int i = 0; i < WIDTH; i++){
+    for(int j = 0; j < HEIGHT; j++){
+      full[i * HEIGHT + j] = values[(frames / 2) * pixels + (i * view.width / WIDTH) * view.height + j * view.height / HEIGHT];
+    }
+  }
+  t = Seconds();
+  CalculateColors(full, histograms + (frames / 2) * MAX_I, nums);
+  color = Seconds() - t;
+  t = Seconds();
+  EncodeFrame(nums, text);
+  encode = Seconds() - t;
+  total = compute + color + encode;
+
+  COMPUTE_THREADS = (int)(best * compute / total + 0.5);
+  COLOR_THREADS = (int)(best * color / total + 0.5);
+  ENCODE_THREADS = (int)(best * encode / total + 0.5);
+  if(COMPUTE_THREADS < 1) COMPUTE_THREADS = 1;
+  if(COLOR_THREADS < 1) COLOR_THREADS = 1;
+  if(ENCODE_THREADS < 1) ENCODE_THREADS = 1;
+  //Enough that every stage always has a frame to work on and one waiting
+  FRAMES_IN_FLIGHT = 2 * (COMPUTE_THREADS + COLOR_THREADS + ENCODE_THREADS);
+  SetPoolThreads(best);
+  printf("per frame: compute %.3fs, color %.3fs, encode %.3fs (one thread each)\n", compute, color, encode);
+
+  mkdir(TUNE_DIR, 0755);
+  TuneProfilePath(path, sizeof(path));
+  fp = fopen(path, "w");
+  if(fp == NULL){
+    printf("Could not write %s\n", path);
+  }else{
+    //The workload it was tuned on, a profile for another sweep isn't used
+    fprintf(fp, "start=%f\nend=%f\nwidth=%d\nheight=%d\nmax_i=%d\n", START, END, WIDTH, HEIGHT, MAX_I);
+    fprintf(fp, "compute_threads=%d\ncolor_threads=%d\nencode_threads=%d\nframes_in_flight=%d\nthreads=%d\n", COMPUTE_THREADS, COLOR_THREADS, ENCODE_THREADS, FRAMES_IN_FLIGHT, best);
+    fclose(fp);
+    printf("Saved %s\n", path);
+  }
+
+  free(powers);
+  free(values);
+  free(histograms);
+  free(full);
+  free(nums);
+  free(text);
+}
+
+//Loads this machine's profile over the defaults. Returns 1 if there was one for this sweep.
+int LoadTuneProfile(){
+  char path[1024], name[64];
+  double value;
+  double start = NAN, end = NAN;
+  int width = 0, height = 0, maxI = 0;
+  int compute = 0, color = 0, encode = 0, inFlight = 0, threads = 0;
+  FILE *fp;
+
+  TuneProfilePath(path, sizeof(path));
+  fp = fopen(path, "r");
+  if(fp == NULL) return 0;
+  while(fscanf(fp, " %63[^=]=%lf", name, &value) == 2){
+    if(strcmp(name, "start") == 0) start = value;
+    else if(strcmp(name, "end") == 0) end = value;
+    else if(strcmp(name, "width") == 0) width = value;
+    else if(strcmp(name, "height") == 0) height = value;
+    else if(strcmp(name, "max_i") == 0) maxI = value;
+    else if(strcmp(name, "compute_threads") == 0) compute = value;
+    else if(strcmp(name, "color_threads") == 0) color = value;
+    else if(strcmp(name, "encode_threads") == 0) encode = value;
+    else if(strcmp(name, "frames_in_flight") == 0) inFlight = value;
+    else if(strcmp(name, "threads") == 0) threads = value;
+  }
+  fclose(fp);
+
+  if(fabs(start - START) > 1e-4 || fabs(end - END) > 1e-4 || width != WIDTH || height != HEIGHT || maxI != MAX_I){
+    printf("The tuning profile %s is for another sweep, run with TUNE = 1 again\n", path);
+    return 0;
+  }
+  if(compute < 1 || color < 1 || encode < 1 || inFlight < 1 || threads < 1) return 0;
+  COMPUTE_THREADS = compute;
+  COLOR_THREADS = color;
+  ENCODE_THREADS = encode;
+  FRAMES_IN_FLIGHT = inFlight;
+  SetPoolThreads(threads);
+  return 1;
+}
+
+//The thread count of every mode that just splits its work over a pool of threads, as tuned.
+//A mode with a new pool goes here, so a tuning run and a loaded profile always set the same ones.
+void SetPoolThreads(int threads){
+  POSTER_THREADS = threads;
+  ATLAS_THREADS = threads;
+  SCHEDULER_THREADS = threads;
+  DZI_THREADS = threads;
+  STATS_THREADS = threads;
+  SPACING_THREADS = threads;
+}
+
+//TUNE_DIR/<cpu model>-<cpus>.tune, with anything but letters and digits in the model turned into _
+void TuneProfilePath(char *path, size_t size){
+  char model[256] = "unknown";
+
+#ifdef __APPLE__
+  size_t length = sizeof(model);
+  if(sysctlbyname("machdep.cpu.brand_string", model, &length, NULL, 0) != 0) strcpy(model, "unknown");
+#else
+  char line[512];
+  FILE *fp = fopen("/proc/cpuinfo", "r");
+  if(fp != NULL){
+    while(fgets(line, sizeof(line), fp) != NULL){
+      char *colon = strchr(line, ':');
+      if(colon != NULL && strncmp(line, "model name", 10) == 0){
+        snprintf(model, sizeof(model), "%s", colon + 2);
+        model[strcspn(model, "\n")] = '\0';
+        break;
+      }
+    }
+    fclose(fp);
+  }
+#endif
+  for(char *c = model; *c != '\0'; c++){
+    if(!((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9'))) *c = '_';
+  }
+  snprintf(path, size, "%s/%s-%ld.tune", TUNE_DIR, model, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+//Renders ZOOM_FRAMES frames along ZOOM_PATH. Consecutive frames mostly show the same points,
+//so each frame starts from the last one's escape counts (moved to where those points are now)
+//and only renders the pixels that don't have one close enough, or that are near a boundary.
+//Whenever the power changes between frames everything gets rendered again.
+void ZoomAnimation(){
+  size_t pixels = (size_t)WIDTH * HEIGHT;
+  float *values = malloc(sizeof(float) * pixels), *prevValues = malloc(sizeof(float) * pixels);
+  //Where each pixel's escape count was actually computed, so reused counts can't drift frame after frame
+  double *sampleRe = malloc(sizeof(double) * pixels), *sampleIm = malloc(sizeof(double) * pixels);
+  double *prevRe = malloc(sizeof(double) * pixels), *prevIm = malloc(sizeof(double) * pixels);
+  float *nums = malloc(sizeof(float) * pixels);
+  float histogram[MAX_I];
+  double prevMinX = 0, prevMinY = 0, prevStep = 1;
+  float prevPower = 0;
+  long rendered = 0;
+
+  for(int frame = 0; frame < ZOOM_FRAMES; frame++){
+    double t = (ZOOM_FRAMES > 1) ? frame / (double)(ZOOM_FRAMES - 1) : 0;
+    double centerX, centerY, range, step, minX, minY;
+    float power;
+    int computed;
+    void *swap;
+
+    ZoomView(t, &centerX, &centerY, &range, &power);
+    step = range / WIDTH;
+    minX = centerX - step * WIDTH / 2;
+    minY = centerY - step * HEIGHT / 2;
+
+    computed = Reproject(values, sampleRe, sampleIm, prevValues, prevRe, prevIm, prevMinX, prevMinY, prevStep, frame > 0 && power == prevPower, minX, minY, step, power);
+    rendered += computed;
+
+    for(int i = 0; i < MAX_I; i++){
+      histogram[i] = 0;
+    }
+    for(size_t i = 0; i < pixels; i++){
+      if(values[i] < MAX_I) histogram[(int)values[i]]++;
+    }
+    CalculateColors(values, histogram, nums);
+    WriteZoomFrame(nums, frame, power, ZOOM_FRAMES);
+    if(SHM) PublishShm(values, nums, frame, power);
+    printf("frame %d/%d, center %.8f + %.8fi, range %g, power %f, rendered %.1f%% of the pixels\n", frame, ZOOM_FRAMES, centerX, centerY, range, power, 100.0 * computed / pixels);
+
+    swap = prevValues; prevValues = values; values = swap;
+    swap = prevRe; prevRe = sampleRe; sampleRe = swap;
+    swap = prevIm; prevIm = sampleIm; sampleIm = swap;
+    prevMinX = minX;
+    prevMinY = minY;
+    prevStep = step;
+    prevPower = power;
+  }
+
+  printf("Rendered %.1f%% of all pixels\n", 100.0 * rendered / ((double)pixels * ZOOM_FRAMES));
+  free(values);
+  free(prevValues);
+  free(sampleRe);
+  free(sampleIm);
+  free(prevRe);
+  free(prevIm);
+  free(nums);
+}
+
+//Where the view is at time t. The range is interpolated in log space so zooming looks like
+//the same speed all the way in. The center moves in step with the range, so whatever is under
+//the next keyframe's center stays put on the screen while zooming instead of flying past.
+void ZoomView(double t, double *centerX, double *centerY, double *range, float *power){
+  int keys = sizeof(ZOOM_PATH) / sizeof(ZOOM_PATH[0]);
+  const struct Keyframe *a = &ZOOM_PATH[0], *b = &ZOOM_PATH[0];
+  double f = 0;
+
+  for(int k = 0; k < keys - 1; k++){
+    if(t >= ZOOM_PATH[k].time){
+      a = &ZOOM_PATH[k];
+      b = &ZOOM_PATH[k + 1];
+    }
+  }
+  if(t >= ZOOM_PATH[keys - 1].time){
+    a = b = &ZOOM_PATH[keys - 1];
+  }
+  if(b->time > a->time) f = (t - a->time) / (b->time - a->time);
+  if(f > 1) f = 1;
+
+  *range = exp(log(a->range) + (log(b->range) - log(a->range)) * f);
+  if(a->range != b->range) f = (a->range - *range) / (a->range - b->range);
+  *centerX = a->centerX + (b->centerX - a->centerX) * f;
+  *centerY = a->centerY + (b->centerY - a->centerY) * f;
+  *power = a->power + (b->power - a->power) * f;
+}
+
+//Fills in one frame of the zoom. A pixel takes the escape count of the nearest pixel of the last
+//frame if it was computed at exactly the same point, or if it was computed within ZOOM_TOLERANCE
+//pixels of it and all 8 of that pixel's neighbors have the same count (so it isn't near a boundary).
+//Every other pixel gets rendered.
+//Returns the number of pixels that had to be rendered.
+int Reproject(float *values, double *sampleRe, double *sampleIm, const float *prevValues, const double *prevRe, const double *prevIm, double prevMinX, double prevMinY, double prevStep, int havePrev, double minX, double minY, double step, float power){
+  double tolerance = ZOOM_TOLERANCE * step;
+  int computed = 0;
+
+  for(int i = 0; i < WIDTH; i++){
+    for(int j = 0; j < HEIGHT; j++){
+      double re = minX + i * step, im = minY + j * step;
+      int reused = 0;
+
+      if(havePrev){
+        long si = lround((re - prevMinX) / prevStep);
+        long sj = lround((im - prevMinY) / prevStep);
+        if(si >= 1 && si < WIDTH - 1 && sj >= 1 && sj < HEIGHT - 1){
+          long source = si * HEIGHT + sj;
+          float n = prevValues[source];
+          if(prevRe[source] == re && prevIm[source] == im){
+            reused = 1;
+          }else if(fabs(prevRe[source] - re) <= tolerance && fabs(prevIm[source] - im) <= tolerance){
+            reused = 1;
+            for(int di = -1; di <= 1 && reused; di++){
+              for(int dj = -1; dj <= 1; dj++){
+                if(prevValues[source + di * HEIGHT + dj] != n){
+                  reused = 0;
+                  break;
+                }
+              }
+            }
+          }
+          if(reused){
+            values[i * HEIGHT + j] = n;
+            sampleRe[i * HEIGHT + j] = prevRe[source];
+            sampleIm[i * HEIGHT + j] = prevIm[source];
+          }
+        }
+      }
+
+      if(!reused){
+        values[i * HEIGHT + j] = Escape(re, im, power, 0, 0, MAX_I);
+        sampleRe[i * HEIGHT + j] = re;
+        sampleIm[i * HEIGHT + j] = im;
+        computed++;
+      }
+    }
+  }
+  return computed;
+}
+
+//PERFILE frames to a JSON file like the power sweep, or all of them into the archive
+struct Archive zoomArchive;
+
+void WriteZoomFrame(float *nums, int frame, float power, int frames){
+  int perFile = (int)PERFILE;
+  int file = frame / perFile;
+
+  if(DZI) PublishDzi(nums, frame);
+  if(ARCHIVE){
+    if(frame == 0 && ArchiveOpen(&zoomArchive, ARCHIVE_PATH, frames, ARCHIVE_ZOOM) != 0){
+      printf("Could not open %s\n", ARCHIVE_PATH);
+      exit(1);
+    }
+    //Frames go in the order of the animation (the header says so with ARCHIVE_ZOOM), each with its real power
+    if(ArchiveAppend(&zoomArchive, power, nums, WIDTH * HEIGHT) != 0){
+      printf("Could not write frame %d to %s\n", frame, ARCHIVE_PATH);
+      exit(1);
+    }
+    if(frame == frames - 1 && ArchiveClose(&zoomArchive) != 0){
+      printf("Could not write %s\n", ARCHIVE_PATH);
+      exit(1);
+    }
+    return;
+  }
+
+  if(frame % perFile == 0) StartWriteToJSON(file);
+  if(frame % perFile == perFile - 1 || frame == frames - 1){
+    LastWriteToJSON(nums, file);
+    FinishWriteToJSON(file);
+  }else{
+    MiddleWriteToJSON(nums, file);
+  }
+}
+
+struct Scheduler scheduler = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+//The job this thread is rendering, so the pixel loops can check on it
+_Thread_local struct Job *currentJob;
+
+void SchedulerStart(int threads){
+  scheduler.stopping = 0;
+  scheduler.threads = threads;
+  scheduler.workers = malloc(sizeof(pthread_t) * threads);
+  for(int i = 0; i < threads; i++){
+    pthread_create(&scheduler.workers[i], NULL, SchedulerWorker, NULL);
+  }
+}
+
+//Finishes whatever is still queued, then stops the workers
+void SchedulerStop(){
+  pthread_mutex_lock(&scheduler.lock);
+  scheduler.stopping = 1;
+  pthread_cond_broadcast(&scheduler.work);
+  pthread_mutex_unlock(&scheduler.lock);
+  for(int i = 0; i < scheduler.threads; i++){
+    pthread_join(scheduler.workers[i], NULL);
+  }
+  free(scheduler.workers);
+}
+
+void* SchedulerWorker(void *arg){
+  pthread_mutex_lock(&scheduler.lock);
+  for(;;){
+    struct Job *job = JobTake(JOB_CLASSES - 1);
+    if(job == NULL){
+      if(scheduler.stopping) break;
+      pthread_cond_wait(&scheduler.work, &scheduler.lock);
+      continue;
+    }
+    pthread_mutex_unlock(&scheduler.lock);
+    JobRun(job);
+    pthread_mutex_lock(&scheduler.lock);
+  }
+  pthread_mutex_unlock(&scheduler.lock);
+  return arg;
+}
+
+struct Job* JobNew(int kind, int priority){
+  struct Job *job = calloc(1, sizeof(struct Job));
+  job->kind = kind;
+  job->priority = priority;
+  job->refs = 2;
+  atomic_init(&job->cancelled, 0);
+  return job;
+}
+
+void JobSubmit(struct Job *job){
+  pthread_mutex_lock(&scheduler.lock);
+  job->state = JOB_QUEUED;
+  if(scheduler.tail[job->priority] != NULL) scheduler.tail[job->priority]->next = job;
+  else scheduler.head[job->priority] = job;
+  scheduler.tail[job->priority] = job;
+  atomic_fetch_add(&scheduler.waiting[job->priority], 1);
+  pthread_cond_signal(&scheduler.work);
+  pthread_mutex_unlock(&scheduler.lock);
+}
+
+//One frame of the default view
+struct Job* SubmitFrame(float power, float cR, float cI, int priority){
+  struct Job *job = JobNew(JOB_FRAME, priority);
+  job->power = power;
+  job->cR = cR;
+  job->cI = cI;
+  job->values = malloc(sizeof(float) * WIDTH * HEIGHT);
+  job->histogram = malloc(sizeof(float) * MAX_I);
+  JobSubmit(job);
+  return job;
+}
+
+struct Job* SubmitTile(struct TileKey key, int priority){
+  struct Job *job = JobNew(JOB_TILE, priority);
+  job->tile = key;
+  job->values = malloc(sizeof(float) * TILE_SIZE * TILE_SIZE);
+  JobSubmit(job);
+  return job;
+}
+
+//Frames firstFrame to firstFrame + frames - 1 of the sweep (powers from FramePower()), one after
+//another on one thread. The whole job runs on the worker that took it, so frameDone gets the
+//job's frames in order and never two at once, but frames of different jobs can be done at the same
+//time and in any order. Submit several to spread a sweep over the workers.
+struct Job* SubmitSweep(int firstFrame, int frames, void (*frameDone)(int frame, float *values, float *histogram), int priority){
+  struct Job *job = JobNew(JOB_SWEEP, priority);
+  job->firstFrame = firstFrame;
+  job->frames = frames;
+  job->frameDone = frameDone;
+  job->values = malloc(sizeof(float) * WIDTH * HEIGHT);
+  job->histogram = malloc(sizeof(float) * MAX_I);
+  JobSubmit(job);
+  return job;
+}
+
+//Pops the oldest job of the most important class that isn't less important than lowest.
+//Must be called with the lock held.
+struct Job* JobTake(int lowest){
+  for(int c = 0; c <= lowest; c++){
+    struct Job *job = scheduler.head[c];
+    if(job == NULL) continue;
+    scheduler.head[c] = job->next;
+    if(scheduler.head[c] == NULL) scheduler.tail[c] = NULL;
+    job->next = NULL;
+    job->state = JOB_RUNNING;
+    atomic_fetch_sub(&scheduler.waiting[c], 1);
+    return job;
+  }
+  return NULL;
+}
+
+void JobRun(struct Job *job){
+  struct Job *outer = currentJob;
+  int state;
+
+  currentJob = job;
+  if(job->kind == JOB_FRAME){
+    memset(job->histogram, 0, sizeof(float) * MAX_I);
+    RenderFrame(job->values, job->histogram, job->power, job->cR, job->cI);
+  }else if(job->kind == JOB_TILE){
+    RenderTile(job->tile, job->values);
+  }else{
+    for(int f = 0; f < job->frames && !JobCancelled(); f++){
+      memset(job->histogram, 0, sizeof(float) * MAX_I);
+      RenderFrame(job->values, job->histogram, FramePower(job->firstFrame + f), 0, 0);
+      if(!JobCancelled()) job->frameDone(job->firstFrame + f, job->values, job->histogram);
+    }
+  }
+  state = JobCancelled() ? JOB_CANCELLED : JOB_DONE;
+  currentJob = outer;
+
+  pthread_mutex_lock(&scheduler.lock);
+  job->state = state;
+  pthread_cond_broadcast(&scheduler.done);
+  pthread_mutex_unlock(&scheduler.lock);
+  JobRelease(job);
+}
+
+//Blocks until the job is done or cancelled, returns which
+int JobWait(struct Job *job){
+  int state;
+  pthread_mutex_lock(&scheduler.lock);
+  while(job->state != JOB_DONE && job->state != JOB_CANCELLED){
+    pthread_cond_wait(&scheduler.done, &scheduler.lock);
+  }
+  state = job->state;
+  pthread_mutex_unlock(&scheduler.lock);
+  return state;
+}
+
+//A queued job is dropped right away, a running one stops at its next checkpoint
+void JobCancel(struct Job *job){
+  atomic_store(&job->cancelled, 1);
+
+  pthread_mutex_lock(&scheduler.lock);
+  if(job->state == JOB_QUEUED){
+    struct Job **link = &scheduler.head[job->priority], *prev = NULL;
+    while(*link != job){
+      prev = *link;
+      link = &(*link)->next;
+    }
+    *link = job->next;
+    if(scheduler.tail[job->priority] == job) scheduler.tail[job->priority] = prev;
+    atomic_fetch_sub(&scheduler.waiting[job->priority], 1);
+    job->state = JOB_CANCELLED;
+    job->refs--;
+    pthread_cond_broadcast(&scheduler.done);
+  }
+  pthread_mutex_unlock(&scheduler.lock);
+}
+
+void JobRelease(struct Job *job){
+  int refs;
+  pthread_mutex_lock(&scheduler.lock);
+  refs = --job->refs;
+  pthread_mutex_unlock(&scheduler.lock);
+  if(refs == 0){
+    free(job->values);
+    free(job->histogram);
+    free(job);
+  }
+}
+
+//Called by the pixel loops once per column. Returns 1 if the job being rendered got cancelled
+//and the loop should stop. A batch job lets any queued interactive jobs run first, right here
+//on this thread, so they never wait for a whole batch frame to finish.
+int JobCheckpoint(){
+  struct Job *job = currentJob;
+
+  if(job == NULL) return 0;
+  while(job->priority > JOB_INTERACTIVE && atomic_load_explicit(&scheduler.waiting[JOB_INTERACTIVE], memory_order_relaxed) > 0){
+    struct Job *urgent;
+    pthread_mutex_lock(&scheduler.lock);
+    urgent = JobTake(JOB_INTERACTIVE);
+    pthread_mutex_unlock(&scheduler.lock);
+    if(urgent == NULL) break;
+    JobRun(urgent);
+  }
+  return JobCancelled();
+}
+
+//Whether the job this thread is rendering got cancelled (0 outside the scheduler)
+int JobCancelled(){
+  return currentJob != NULL && atomic_load_explicit(&currentJob->cancelled, memory_order_relaxed);
+}
+
+//SCHEDULER mode. The sweep goes in as one batch job per JSON file, and since a job's frames are
+//done in order on one worker every file is still written in order. The tile server's renders come
+//in as interactive jobs.
+void ScheduledSweep(){
+  int files = FrameFile(DIVISIONS) + 1;
+  struct Job **jobs;
+  pthread_t server;
+
+  if(ARCHIVE){
+    printf("SCHEDULER only writes JSON files, turn ARCHIVE off or use PIPELINE for an archive\n");
+    exit(1);
+  }
+  jobs = malloc(sizeof(struct Job*) * files);
+
+  SchedulerStart(SCHEDULER_THREADS);
+  pthread_create(&server, NULL, TileServerThread, NULL);
+  pthread_detach(server);
+
+  for(int f = 0; f < files; f++){
+    jobs[f] = SubmitSweep(FileFirstFrame(f), FileLastFrame(f) - FileFirstFrame(f) + 1, SweepFrameDone, JOB_BATCH);
+  }
+  for(int f = 0; f < files; f++){
+    JobWait(jobs[f]);
+    JobRelease(jobs[f]);
+  }
+
+  SchedulerStop();
+  free(jobs);
+}
+
+void* TileServerThread(void *arg){
+  TileServer();
+  return arg;
+}
+
+//Several workers can finish frames at once, but the shared memory and the pyramids take one at a time
+pthread_mutex_t sweepPublishLock = PTHREAD_MUTEX_INITIALIZER;
+
+//A frame of one of ScheduledSweep()'s jobs, which each hold exactly one file's frames
+void SweepFrameDone(int frame, float *values, float *histogram){
+  int file = FrameFile(frame);
+  float *nums = malloc(sizeof(float) * WIDTH * HEIGHT);
+
+  CalculateColors(values, histogram, nums);
+  if(DZI || SHM){
+    pthread_mutex_lock(&sweepPublishLock);
+    if(DZI) PublishDzi(nums, frame);
+    if(SHM) PublishShm(values, nums, frame, FramePower(frame));
+    pthread_mutex_unlock(&sweepPublishLock);
+  }
+  if(frame == FileFirstFrame(file)) StartWriteToJSON(file);
+  if(frame == FileLastFrame(file)){
+    LastWriteToJSON(nums, file);
+    FinishWriteToJSON(file);
+  }else{
+    MiddleWriteToJSON(nums, file);
+  }
+  printf("power: %f, %d/%d iterations, %f%%\n", FramePower(frame), frame, DIVISIONS, (100.0 * frame) / DIVISIONS);
+  free(nums);
+}
+
+//The pyramid published last stays around (with its frame) so the next one can reuse its unchanged tiles
+struct Pyramid dziPyramids[2];
+int dziPublished = 0;
+int dziLastFrame = -1;
+
+//Writes a colored frame (what CalculateColors() gives) as frame_N.dzi plus frame_N_files/level/col_row.png,
+//N being the frame. Each level is half the size of the one above it, averaged down in parallel from the
+//full size frame. Tiles are only linked to the last pyramid if that was frame N - 1 (the coarse to fine
+//pipeline and the scheduler publish frames out of order). Not thread safe: the scheduler's workers hold
+//sweepPublishLock around it, every other mode calls it from one thread only.
+void PublishDzi(const float *nums, int frame){
+  struct Pyramid *current = &dziPyramids[dziPublished % 2], *previous = &dziPyramids[(dziPublished + 1) % 2];
+  struct DziTask task;
+  char path[1024];
+  int size = (WIDTH > HEIGHT) ? WIDTH : HEIGHT;
+  int levels = 1;
+  int written = 0, linked = 0;
+  double start = Seconds();
+  FILE *fp;
+
+  while((1 << (levels - 1)) < size) levels++;
+  if(current->levels == 0){
+    current->levels = levels;
+    for(int l = levels - 1, w = WIDTH, h = HEIGHT; l >= 0; l--, w = (w + 1) / 2, h = (h + 1) / 2){
+      current->width[l] = w;
+      current->height[l] = h;
+      current->rgb[l] = malloc((size_t)w * h * 3);
+    }
+  }
+
+  mkdir(DZI_DIR, 0755);
+  snprintf(path, sizeof(path), "%s/frame_%06d_files", DZI_DIR, frame);
+  mkdir(path, 0755);
+
+  memset(&task, 0, sizeof(task));
+  task.current = current;
+  task.previous = (dziLastFrame >= 0 && dziLastFrame == frame - 1) ? previous : NULL;
+  task.nums = nums;
+  task.frame = frame;
+
+  task.level = levels - 1;
+  DziRun(&task, HEIGHT, DziColorRow);
+  for(int l = levels - 1; l >= 0; l--){
+    int cols = (current->width[l] + DZI_TILE - 1) / DZI_TILE;
+    int rows = (current->height[l] + DZI_TILE - 1) / DZI_TILE;
+
+    task.level = l;
+    if(l < levels - 1) DziRun(&task, current->height[l], DziDownsampleRow);
+    snprintf(path, sizeof(path), "%s/frame_%06d_files/%d", DZI_DIR, frame, l);
+    mkdir(path, 0755);
+    DziRun(&task, cols * rows, DziTile);
+    written += atomic_load(&task.written);
+    linked += atomic_load(&task.linked);
+  }
+
+  snprintf(path, sizeof(path), "%s/frame_%06d.dzi", DZI_DIR, frame);
+  fp = fopen(path, "w");
+  if(fp != NULL){
+    fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(fp, "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"%d\" Overlap=\"0\" Format=\"png\">\n", DZI_TILE);
+    fprintf(fp, "  <Size Width=\"%d\" Height=\"%d\"/>\n</Image>\n", WIDTH, HEIGHT);
+    fclose(fp);
+  }
+
+  printf("dzi: frame %d, %d tiles written, %d unchanged, %.3fs\n", frame, written, linked, Seconds() - start);
+  dziPublished++;
+  dziLastFrame = frame;
+}
+
+//Runs body for every index from 0 to count - 1 on DZI_THREADS threads
+void DziRun(struct DziTask *task, int count, void (*body)(struct DziTask *task, int index)){
+  pthread_t *threads = malloc(sizeof(pthread_t) * DZI_THREADS);
+
+  task->count = count;
+  task->body = body;
+  atomic_store(&task->next, 0);
+  atomic_store(&task->written, 0);
+  atomic_store(&task->linked, 0);
+  for(int i = 0; i < DZI_THREADS; i++){
+    pthread_create(&threads[i], NULL, DziWorker, task);
+  }
+  for(int i = 0; i < DZI_THREADS; i++){
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+}
+
+void* DziWorker(void *arg){
+  struct DziTask *task = arg;
+  int index;
+  while((index = atomic_fetch_add(&task->next, 1)) < task->count){
+    task->body(task, index);
+  }
+  return NULL;
+}
+
+//Full size level, straight from the frame (which is stored a column at a time)
+void DziColorRow(struct DziTask *task, int y){
+  unsigned char *row = task->current->rgb[task->level] + (size_t)y * WIDTH * 3;
+  for(int x = 0; x < WIDTH; x++){
+    HueToRGB(task->nums[x * HEIGHT + y], row + x * 3);
+  }
+}
+
+//Every pixel is the average of the 2x2 block under it in the level above (fewer at the edges)
+void DziDownsampleRow(struct DziTask *task, int y){
+  struct Pyramid *p = task->current;
+  int l = task->level;
+  int srcW = p->width[l + 1], srcH = p->height[l + 1];
+  unsigned char *row = p->rgb[l] + (size_t)y * p->width[l] * 3;
+
+  for(int x = 0; x < p->width[l]; x++){
+    for(int c = 0; c < 3; c++){
+      int sum = 0, n = 0;
+      for(int dy = 0; dy < 2 && 2 * y + dy < srcH; dy++){
+        for(int dx = 0; dx < 2 && 2 * x + dx < srcW; dx++){
+          sum += p->rgb[l + 1][((size_t)(2 * y + dy) * srcW + 2 * x + dx) * 3 + c];
+          n++;
+        }
+      }
+      row[x * 3 + c] = (sum + n / 2) / n;
+    }
+  }
+}
+
+//Links the tile to last frame's copy if its pixels are the same, writes it otherwise
+void DziTile(struct DziTask *task, int index){
+  int l = task->level;
+  int w = task->current->width[l], h = task->current->height[l];
+  int cols = (w + DZI_TILE - 1) / DZI_TILE;
+  int col = index % cols, row = index / cols;
+  int tileW = (w - col * DZI_TILE < DZI_TILE) ? w - col * DZI_TILE : DZI_TILE;
+  int tileH = (h - row * DZI_TILE < DZI_TILE) ? h - row * DZI_TILE : DZI_TILE;
+  size_t offset = ((size_t)row * DZI_TILE * w + col * DZI_TILE) * 3;
+  char path[1024], previousPath[1024];
+
+  DziTilePath(path, sizeof(path), task->frame, l, col, row);
+  if(task->previous != NULL){
+    int same = 1;
+    for(int y = 0; y < tileH && same; y++){
+      same = memcmp(task->current->rgb[l] + offset + (size_t)y * w * 3, task->previous->rgb[l] + offset + (size_t)y * w * 3, tileW * 3) == 0;
+    }
+    DziTilePath(previousPath, sizeof(previousPath), task->frame - 1, l, col, row);
+    if(same && link(previousPath, path) == 0){
+      atomic_fetch_add(&task->linked, 1);
+      return;
+    }
+  }
+  if(WritePNG(path, task->current->rgb[l] + offset, w * 3, tileW, tileH) != 0){
+    printf("Could not write %s\n", path);
+  }
+  atomic_fetch_add(&task->written, 1);
+}
+
+void DziTilePath(char *path, size_t size, int frame, int level, int col, int row){
+  snprintf(path, size, "%s/frame_%06d_files/%d/%d_%d.png", DZI_DIR, frame, level, col, row);
+}
+
+//Writes an 8 bit RGB PNG. There is no zlib here, so the image data goes in uncompressed
+//(stored deflate blocks), which every PNG reader handles. Returns 0 if it worked.
+int WritePNG(const char *path, const unsigned char *rgb, int stride, int width, int height){
+  static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+  size_t rowBytes = (size_t)width * 3 + 1;
+  size_t raw = rowBytes * height;
+  size_t blocks = (raw + 65534) / 65535;
+  size_t idatLength = 2 + raw + 5 * blocks + 4;
+  unsigned char *idat = malloc(8 + idatLength + 4);
+  unsigned char ihdr[8 + 13 + 4] = {0, 0, 0, 13, 'I', 'H', 'D', 'R'};
+  unsigned char iend[12] = {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82};
+  unsigned char *p = idat + 8;
+  uint32_t a = 1, b = 0, crc;
+  size_t done = 0;
+  FILE *fp;
+
+  ihdr[8] = width >> 24; ihdr[9] = width >> 16; ihdr[10] = width >> 8; ihdr[11] = width;
+  ihdr[12] = height >> 24; ihdr[13] = height >> 16; ihdr[14] = height >> 8; ihdr[15] = height;
+  ihdr[16] = 8;
+  ihdr[17] = 2;
+  crc = Crc32(0, ihdr + 4, 17);
+  ihdr[21] = crc >> 24; ihdr[22] = crc >> 16; ihdr[23] = crc >> 8; ihdr[24] = crc;
+
+  idat[0] = idatLength >> 24; idat[1] = idatLength >> 16; idat[2] = idatLength >> 8; idat[3] = idatLength;
+  memcpy(idat + 4, "IDAT", 4);
+  *p++ = 0x78;
+  *p++ = 0x01;
+  //Each row is a filter byte (0, none) and the pixels, split into blocks of at most 65535 bytes
+  for(size_t block = 0; block < blocks; block++){
+    size_t length = (raw - done < 65535) ? raw - done : 65535;
+    *p++ = (block == blocks - 1);
+    *p++ = length; *p++ = length >> 8;
+    *p++ = ~length; *p++ = ~length >> 8;
+    for(size_t i = 0; i < length; i++, done++){
+      size_t x = done % rowBytes;
+      unsigned char byte = (x == 0) ? 0 : rgb[(done / rowBytes) * stride + x - 1];
+      *p++ = byte;
+      a = (a + byte) % 65521;
+      b = (b + a) % 65521;
+    }
+  }
+  *p++ = b >> 8; *p++ = b; *p++ = a >> 8; *p++ = a;
+  crc = Crc32(0, idat + 4, 4 + idatLength);
+  *p++ = crc >> 24; *p++ = crc >> 16; *p++ = crc >> 8; *p++ = crc;
+
+  fp = fopen(path, "wb");
+  if(fp == NULL){
+    free(idat);
+    return 1;
+  }
+  fwrite(signature, 1, sizeof(signature), fp);
+  fwrite(ihdr, 1, sizeof(ihdr), fp);
+  fwrite(idat, 1, p - idat, fp);
+  fwrite(iend, 1, sizeof(iend), fp);
+  free(idat);
+  return fclose(fp) != 0;
+}
+
+uint32_t crcTable[256];
+pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+//The CRC PNG chunks end with (same as zlib's crc32())
+uint32_t Crc32(uint32_t crc, const unsigned char *data, size_t length){
+  pthread_once(&crcOnce, CrcTable);
+  crc = ~crc;
+  for(size_t i = 0; i < length; i++){
+    crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void CrcTable(){
+  for(uint32_t n = 0; n < 256; n++){
+    uint32_t c = n;
+    for(int k = 0; k < 8; k++){
+      c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    }
+    crcTable[n] = c;
+  }
+}
+
+//Mandelbrot() that picks up from the frame's orbit file in CONTINUE_DIR if there is one. Points that
+//escaped are final, the ones that hadn't escaped by the stored MAX_I resume from where they stopped.
+//Afterwards the file is updated to this MAX_I. A file from a bigger MAX_I works too, its counts just
+//get cut off at this MAX_I (and the file is left alone).
+void ContinueMandelbrot(float *values, float *histogram, float power, float cR, float cI){
+  struct FrameKey key;
+  struct OrbitState *states = NULL;
+  int count = 0, storedMaxI, kept = 0;
+
+  //Same frame no matter the budget, and before antialiasing, which changes the counts
+  MakeFrameKey(&key, power, cR, cI);
+  key.maxI = 0;
+  key.aaGrid = key.aaBudget = 0;
+
+  storedMaxI = OrbitLoad(&key, values, &states, &count);
+  if(storedMaxI == 0){
+    //Nothing stored yet, every point starts at z = p
+    states = malloc(sizeof(struct OrbitState) * WIDTH * HEIGHT);
+    for(int i = 0; i < WIDTH; i++){
+      for(int j = 0; j < HEIGHT; j++){
+        states[count].index = i * HEIGHT + j;
+        states[count].zRe = map(i, 0, WIDTH, MIN_X, MAX_X);
+        states[count].zIm = map(j, 0, HEIGHT, MIN_Y, MAX_Y);
+        values[i * HEIGHT + j] = 0;
+        count++;
+      }
+    }
+  }
+
+  if(storedMaxI <= MAX_I){
+    for(int k = 0; k < count; k++){
+      int i = states[k].index / HEIGHT, j = states[k].index % HEIGHT;
+      float re = map(i, 0, WIDTH, MIN_X, MAX_X), im = map(j, 0, HEIGHT, MIN_Y, MAX_Y);
+      float radius = BAILOUT ? MandelbrotBailout(re, im, power, cR, cI) : 4;
+
+      if(k % HEIGHT == 0 && JobCheckpoint()) break;
+      values[states[k].index] = MandelbrotResumeWithin(re, im, power, cR, cI, MAX_I, &states[k].zRe, &states[k].zIm, (int)values[states[k].index], radius);
+      if(values[states[k].index] == MAX_I) states[kept++] = states[k];
+    }
+  }
+
+  for(int i = 0; i < WIDTH * HEIGHT; i++){
+    if(values[i] > MAX_I) values[i] = MAX_I;
+    if(values[i] < MAX_I) histogram[(int)values[i]]++;
+  }
+  if(storedMaxI < MAX_I && !JobCancelled()){
+    key.maxI = MAX_I;
+    OrbitStore(&key, values, states, kept);
+  }
+  free(states);
+}
+
+//Returns the MAX_I the frame's orbit file was rendered with (0 if there isn't one) and fills values
+//with its escape counts and states with the points that hadn't escaped, which the caller frees.
+//A file is the key (maxI set to the MAX_I it was rendered with), the number of states, the values, then the states.
+int OrbitLoad(const struct FrameKey *key, float *values, struct OrbitState **states, int *count){
+  char path[1024];
+  struct FrameKey stored, match = *key;
+  int32_t stateCount;
+  FILE *fp;
+  int found;
+
+  snprintf(path, sizeof(path), "%s/%016llx.orbit", CONTINUE_DIR, (unsigned long long)Hash64(key, sizeof(struct FrameKey)));
+  fp = fopen(path, "rb");
+  if(fp == NULL) return 0;
+
+  found = fread(&stored, sizeof(stored), 1, fp) == 1 && stored.maxI > 0;
+  match.maxI = stored.maxI;
+  found = found && memcmp(&stored, &match, sizeof(stored)) == 0
+    && fread(&stateCount, sizeof(stateCount), 1, fp) == 1 && stateCount >= 0 && stateCount <= WIDTH * HEIGHT
+    && fread(values, sizeof(float), (size_t)WIDTH * HEIGHT, fp) == (size_t)WIDTH * HEIGHT;
+  if(found){
+    *states = malloc(sizeof(struct OrbitState) * (stateCount > 0 ? stateCount : 1));
+    found = fread(*states, sizeof(struct OrbitState), stateCount, fp) == (size_t)stateCount;
+    if(!found){
+      free(*states);
+      *states = NULL;
+    }
+  }
+  fclose(fp);
+
+  if(!found) return 0;
+  *count = stateCount;
+  return stored.maxI;
+}
+
+//The file is named after the key without its maxI, so every MAX_I finds the same one
+void OrbitStore(const struct FrameKey *key, const float *values, const struct OrbitState *states, int count){
+  char path[1024], temp[1100];
+  struct FrameKey name = *key;
+  int32_t stateCount = count;
+  FILE *fp;
+  int ok;
+
+  name.maxI = 0;
+  mkdir(CONTINUE_DIR, 0755);
+  snprintf(path, sizeof(path), "%s/%016llx.orbit", CONTINUE_DIR, (unsigned long long)Hash64(&name, sizeof(struct FrameKey)));
+  snprintf(temp, sizeof(temp), "%s.%d.%lu.tmp", path, (int)getpid(), (unsigned long)pthread_self());
+  fp = fopen(temp, "wb");
+  if(fp == NULL) return;
+
+  ok = fwrite(key, sizeof(struct FrameKey), 1, fp) == 1
+    && fwrite(&stateCount, sizeof(stateCount), 1, fp) == 1
+    && fwrite(values, sizeof(float), (size_t)WIDTH * HEIGHT, fp) == (size_t)WIDTH * HEIGHT
+    && fwrite(states, sizeof(struct OrbitState), count, fp) == (size_t)count;
+  ok = (fclose(fp) == 0) && ok;
+  if(!ok || rename(temp, path) != 0) unlink(temp);
+}
+
+//Works out the statistics of every frame of the sweep on STATS_THREADS threads and writes them to STATS_PATH
+void SweepStats(){
+  struct StatsHeader header = {STATS_MAGIC, STATS_VERSION, WIDTH, HEIGHT, MAX_I, DIVISIONS + 1, MIN_X, MAX_X, MIN_Y, MAX_Y};
+  pthread_t *threads = malloc(sizeof(pthread_t) * STATS_THREADS);
+  struct Stats stats;
+  double start = Seconds();
+
+  stats.fd = open(STATS_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(stats.fd < 0 || pwrite(stats.fd, &header, sizeof(header), 0) != sizeof(header)){
+    printf("Could not write %s\n", STATS_PATH);
+    if(stats.fd >= 0) close(stats.fd);
+    free(threads);
+    return;
+  }
+  atomic_store(&stats.next, 0);
+
+  for(int t = 0; t < STATS_THREADS; t++){
+    pthread_create(&threads[t], NULL, StatsWorker, &stats);
+  }
+  for(int t = 0; t < STATS_THREADS; t++){
+    pthread_join(threads[t], NULL);
+  }
+
+  close(stats.fd);
+  printf("Statistics for %d frames in %f seconds\n", DIVISIONS + 1, Seconds() - start);
+  free(threads);
+}
+
+//Takes frames off the shared counter, each record goes straight to its place in the file
+void* StatsWorker(void *arg){
+  struct Stats *stats = arg;
+  size_t size = sizeof(struct StatsRecord) + sizeof(uint32_t) * MAX_I;
+  unsigned char *record = malloc(size);
+  int *columns = malloc(sizeof(int) * 2 * HEIGHT);
+  int frame;
+
+  while((frame = atomic_fetch_add(&stats->next, 1)) <= DIVISIONS){
+    float power = FramePower(frame);
+    FrameStats(power, columns, (struct StatsRecord*)record, (uint32_t*)(record + sizeof(struct StatsRecord)));
+    if(pwrite(stats->fd, record, size, sizeof(struct StatsHeader) + (off_t)frame * size) != (ssize_t)size){
+      printf("Could not write frame %d to %s\n", frame, STATS_PATH);
+    }
+    printf("power: %f, %d/%d iterations, %f%%\n", power, frame, DIVISIONS, (100.0 * frame) / DIVISIONS);
+  }
+
+  free(record);
+  free(columns);
+  return NULL;
+}
+
+//Same pixels as Mandelbrot(), but the escape counts are only kept for the column before this one, which
+//is all the boundary needs. columns has room for 2 * HEIGHT ints.
+void FrameStats(float power, int *columns, struct StatsRecord *record, uint32_t *histogram){
+  float stepX = RANGE_X / WIDTH, stepY = RANGE_Y / HEIGHT;
+  uint32_t inside = 0, edgesX = 0, edgesY = 0;
+  double total = 0;
+
+  memset(histogram, 0, sizeof(uint32_t) * MAX_I);
+  for(int i = 0; i < WIDTH; i++){
+    int *column = columns + (i % 2) * HEIGHT;
+    int *previous = columns + ((i + 1) % 2) * HEIGHT;
+    for(int j = 0; j < HEIGHT; j++){
+      int n = Escape(map(i, 0, WIDTH, MIN_X, MAX_X), map(j, 0, HEIGHT, MIN_Y, MAX_Y), power, 0, 0, MAX_I);
+      column[j] = n;
+      if(n < MAX_I){
+        histogram[n]++;
+        total += n;
+      }else{
+        inside++;
+      }
+      //Edges with the pixel above (as long as stepX) and the one to the left (as long as stepY)
+      if(j > 0 && (n == MAX_I) != (column[j - 1] == MAX_I)) edgesX++;
+      if(i > 0 && (n == MAX_I) != (previous[j] == MAX_I)) edgesY++;
+    }
+  }
+
+  record->power = power;
+  record->inside = inside;
+  record->area = inside * stepX * stepY;
+  record->meanEscape = (inside < (uint32_t)(WIDTH * HEIGHT)) ? total / (WIDTH * HEIGHT - inside) : 0;
+  record->boundary = edgesX * stepX + edgesY * stepY;
+}
+
+struct ShmHeader *shmHeader = NULL;
+size_t shmSize = 0;
+
+//Copies a frame into the next slot of the shared memory, making it the first time through. There is
+//only one writer, so callers on different threads (the scheduler's workers) take turns with a lock.
+void PublishShm(const float *values, const float *nums, int frame, float power){
+  struct ShmSlot *slots;
+  struct ShmSlot *slot;
+  uint32_t n;
+
+  if(shmHeader == NULL){
+    uint64_t slotBytes = ((uint64_t)WIDTH * HEIGHT * sizeof(float) + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+    uint64_t dataOffset = (sizeof(struct ShmHeader) + sizeof(struct ShmSlot) * SHM_SLOTS + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+    int fd;
+
+    //A reader still mapping the last sweep's memory keeps it, this sweep gets a new one
+    shm_unlink(SHM_NAME);
+    fd = shm_open(SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0644);
+    shmSize = dataOffset + slotBytes * SHM_SLOTS;
+    if(fd < 0 || ftruncate(fd, shmSize) != 0){
+      printf("Could not make the shared memory %s\n", SHM_NAME);
+      exit(1);
+    }
+    shmHeader = mmap(NULL, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shmHeader == MAP_FAILED){
+      printf("Could not map the shared memory %s\n", SHM_NAME);
+      exit(1);
+    }
+    shmHeader->width = WIDTH;
+    shmHeader->height = HEIGHT;
+    shmHeader->slots = SHM_SLOTS;
+    shmHeader->raw = SHM_RAW;
+    shmHeader->slotBytes = slotBytes;
+    shmHeader->dataOffset = dataOffset;
+    shmHeader->version = SHM_VERSION;
+    //Last, so a reader that sees the magic sees the rest
+    atomic_store(&shmHeader->magic, SHM_MAGIC);
+  }
+
+  slots = (struct ShmSlot*)(shmHeader + 1);
+  n = atomic_load(&shmHeader->published);
+  slot = &slots[n % SHM_SLOTS];
+  atomic_store(&slot->sequence, 2 * n + 1);
+  slot->frame = frame;
+  slot->power = power;
+  memcpy((char*)shmHeader + shmHeader->dataOffset + (n % SHM_SLOTS) * shmHeader->slotBytes, SHM_RAW ? values : nums, sizeof(float) * WIDTH * HEIGHT);
+  atomic_store(&slot->sequence, 2 * n + 2);
+  atomic_store(&shmHeader->published, n + 1);
+  ShmWake(&shmHeader->published);
+}
+
+//Tells the readers the sweep is over. The memory stays until the next sweep replaces it, so they can finish.
+void ShmStop(){
+  if(shmHeader == NULL) return;
+  atomic_store(&shmHeader->done, 1);
+  ShmWake(&shmHeader->published);
+  munmap(shmHeader, shmSize);
+  shmHeader = NULL;
+}
+
+//Wakes every reader waiting on word
+void ShmWake(_Atomic uint32_t *word){
+#ifdef __linux__
+  syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+  (void)word;
+#endif
+}
+
+//Works out how long the sweep will take and splits it into shards.
+//1. Renders ESTIMATE_SAMPLES frames evenly spread over the sweep at low resolution, timing each one and
+//   adding up the iterations it took (points inside the set count MAX_I).
+//2. Fits seconds = a * iterations + b over the samples. Iterations don't jump around like the times do,
+//   so the fit smooths out the timing noise, and b covers the cost per pixel that doesn't depend on them.
+//3. Every frame of the sweep gets its iterations interpolated between the two samples around it, scaled up
+//   to full size, run through the fit, plus coloring and encoding (timed on a few full size frames).
+//4. Shards are whole JSON files, cut where the running total of the cost passes each 1 / ESTIMATE_SHARDS of it.
+void EstimateSweep(){
+  struct MandelbrotView view = {CENTER_X, CENTER_Y, RANGE_X, RANGE_Y, WIDTH / ESTIMATE_SHRINK, HEIGHT / ESTIMATE_SHRINK};
+  int pixels = view.width * view.height;
+  int samples = (ESTIMATE_SAMPLES < DIVISIONS + 1) ? ESTIMATE_SAMPLES : DIVISIONS + 1;
+  int files = FrameFile(DIVISIONS) + 1;
+  int timed = 0, shards = 0;
+  double scale = (double)WIDTH * HEIGHT / pixels;
+  int *frames = malloc(sizeof(int) * samples);
+  double *seconds = malloc(sizeof(double) * samples);
+  double *iterations = malloc(sizeof(double) * samples);
+  double *cost = malloc(sizeof(double) * (DIVISIONS + 1));
+  float *values = malloc(sizeof(float) * pixels);
+  float *histogram = malloc(sizeof(float) * MAX_I);
+  float *full = malloc(sizeof(float) * WIDTH * HEIGHT);
+  float *nums = malloc(sizeof(float) * WIDTH * HEIGHT);
+  char *text = malloc((size_t)WIDTH * HEIGHT * 12 + 16);
+  double sumI = 0, sumT = 0, sumII = 0, sumIT = 0, a, b;
+  double color = 0, encode = 0, textBytes = 0, total = 0, longest = 0, size, t;
+  FILE *fp;
+
+  if(samples < 2) samples = 2;
+  for(int k = 0; k < samples; k++){
+    double n = 0;
+
+    frames[k] = (int)((long)k * DIVISIONS / (samples - 1));
+    t = Seconds();
+    MandelbrotRender(&view, FramePower(frames[k]), 0, 0, MAX_I, values, histogram);
+    seconds[k] = Seconds() - t;
+    for(int i = 0; i < pixels; i++){
+      n += values[i];
+    }
+    iterations[k] = n;
+    sumI += n;
+    sumT += seconds[k];
+    sumII += n * n;
+    sumIT += n * seconds[k];
+
+    //Coloring and encoding barely depend on what's in the frame, a few of the samples blown up to full size are enough
+    if(k % ((samples + 7) / 8) == 0){
+      for(int i = 0; i < WIDTH; i++){
+        for(int j = 0; j < HEIGHT; j++){
+          full[i * HEIGHT + j] = values[(i * view.width / WIDTH) * view.height + j * view.height / HEIGHT];
+        }
+      }
+      t = Seconds();
+      CalculateColors(full, histogram, nums);
+      color += Seconds() - t;
+      t = Seconds();
+      textBytes += EncodeFrame(nums, text) + 4;
+      encode += Seconds() - t;
+      timed++;
+    }
+  }
+  color /= timed;
+  encode /= timed;
+  textBytes /= timed;
+  if(ARCHIVE || STATS) encode = 0;
+  if(STATS) color = 0;
+
+  b = (samples * sumII - sumI * sumI != 0) ? (sumT * sumII - sumI * sumIT) / (samples * sumII - sumI * sumI) : 0;
+  a = (sumI > 0) ? (sumT - samples * b) / sumI : 0;
+  if(a <= 0 || b < 0){
+    a = (sumI > 0) ? sumT / sumI : 0;
+    b = (sumI > 0) ? 0 : sumT / samples;
+  }
+
+  for(int f = 0, k = 0; f <= DIVISIONS; f++){
+    double x, n;
+    while(k < samples - 2 && frames[k + 1] <= f) k++;
+    x = (double)(f - frames[k]) / (frames[k + 1] - frames[k]);
+    n = iterations[k] + x * (iterations[k + 1] - iterations[k]);
+    cost[f] = scale * (a * n + b) + color + encode;
+    total += cost[f];
+    if(cost[f] > longest) longest = cost[f];
+  }
+
+  printf("power      seconds/frame\n");
+  for(int k = 0; k < samples; k += (samples + 19) / 20){
+    printf("%10f %10.3f\n", FramePower(frames[k]), cost[frames[k]]);
+  }
+  printf("%d frames, %.2f CPU-hours (%.1fs per billion iterations, %.3fs to color and %.3fs to encode a frame)\n", DIVISIONS + 1, total / 3600, a * 1e9, color, encode);
+  printf("Wall time on %d cores: %.2f hours\n", ESTIMATE_CORES, total / ESTIMATE_CORES / 3600);
+
+  if(STATS){
+    size = sizeof(struct StatsHeader) + (DIVISIONS + 1.0) * (sizeof(struct StatsRecord) + sizeof(uint32_t) * MAX_I);
+  }else if(ARCHIVE){
+    size = (sizeof(struct ArchiveHeader) + (DIVISIONS + 1.0) * sizeof(struct ArchiveEntry) + ARCHIVE_ALIGN)
+      + (DIVISIONS + 1.0) * ((WIDTH * HEIGHT * sizeof(float) + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN);
+  }else{
+    size = (DIVISIONS + 1.0) * textBytes + files * 100.0;
+  }
+  printf("Output: about %.2f GB\n", size / 1e9);
+
+  fp = fopen(SHARD_PATH, "w");
+  if(fp == NULL){
+    printf("Could not write %s\n", SHARD_PATH);
+  }else{
+    double done = 0, shardCost = 0;
+    int first = 0;
+
+    fprintf(fp, "#shard first_frame last_frame cpu_seconds\n");
+    printf("shard  frames            CPU-hours  wall on %d cores (h)\n", ESTIMATE_CORES);
+    for(int f = 0; f < files; f++){
+      int last = FileLastFrame(f);
+      double fileCost = 0;
+
+      for(int i = FileFirstFrame(f); i <= last; i++){
+        fileCost += cost[i];
+      }
+      done += fileCost;
+      shardCost += fileCost;
+      //Cut after this file if that's closer to the shard's share than cutting after the next one, but
+      //always leave at least one file for each shard still to come
+      if(f == files - 1 || (shards < ESTIMATE_SHARDS - 1 && (done >= total * (shards + 1) / ESTIMATE_SHARDS - fileCost / 2 || files - f - 1 <= ESTIMATE_SHARDS - shards - 1))){
+        fprintf(fp, "%d %d %d %f\n", shards, first, last, shardCost);
+        printf("%5d  %6d to %6d %11.2f %14.2f\n", shards, first, last, shardCost / 3600, shardCost / ESTIMATE_CORES / 3600);
+        shards++;
+        first = last + 1;
+        shardCost = 0;
+      }
+    }
+    fclose(fp);
+    printf("Saved %d shards to %s\n", shards, SHARD_PATH);
+  }
+  if(longest > total / ESTIMATE_CORES) printf("The slowest frame alone takes %.1fs, more than the sweep on %d cores\n", longest, ESTIMATE_CORES);
+
+  free(frames);
+  free(seconds);
+  free(iterations);
+  free(cost);
+  free(values);
+  free(histogram);
+  free(full);
+  free(nums);
+  free(text);
+}
+
+//Reads the frames of one shard from SHARD_PATH. Returns -1 if it isn't there.
+int LoadShard(int shard, int *first, int *last){
+  char line[256];
+  int number, a, b;
+  FILE *fp = fopen(SHARD_PATH, "r");
+
+  if(fp == NULL) return -1;
+  while(fgets(line, sizeof(line), fp) != NULL){
+    if(line[0] == '#') continue;
+    if(sscanf(line, "%d %d %d", &number, &a, &b) == 3 && number == shard && a >= 0 && a <= b && b <= DIVISIONS){
+      *first = a;
+      *last = b;
+      fclose(fp);
+      return 0;
+    }
+  }
+  fclose(fp);
+  return -1;
+}
+
+//Spreads the frames out by how much the set changes. The change between two neighboring samples is the mean
+//difference in escape count over the pixels (points inside count MAX_I). Frame f goes where the running total of
+//change (plus SPACING_FLOOR of the average per sample, so quiet stretches aren't skipped) is f / DIVISIONS of the
+//way through, interpolating between samples. Its time is how far through the real change (no floor) it is.
+void MeasureSpacing(){
+  struct MandelbrotView view = {CENTER_X, CENTER_Y, RANGE_X, RANGE_Y, WIDTH / SPACING_SHRINK, HEIGHT / SPACING_SHRINK};
+  int pixels = view.width * view.height;
+  int samples = (SPACING_SAMPLES < 2) ? 2 : SPACING_SAMPLES;
+  int chunk = 256;
+  float *powers = malloc(sizeof(float) * samples);
+  float *values = malloc(sizeof(float) * (size_t)(chunk + 1) * pixels);
+  float *histograms = malloc(sizeof(float) * chunk * MAX_I);
+  double *change = calloc(samples, sizeof(double));
+  double *weighted = calloc(samples, sizeof(double));
+  double mean, largest = 0, frameLargest = 0, previousTime = 0;
+  double start = Seconds();
+  FILE *fp;
+
+  for(int k = 0; k < samples; k++){
+    powers[k] = START + (END - START) * (double)k / (samples - 1);
+  }
+
+  //Rendered chunk samples at a time, the last one of each chunk is kept at the front to compare with the next
+  for(int first = 0; first < samples; first += chunk){
+    int count = (samples - first < chunk) ? samples - first : chunk;
+    float *frames = values + pixels;
+
+    MandelbrotRenderBatch(&view, powers + first, count, 0, 0, MAX_I, frames, histograms, SPACING_THREADS);
+    for(int k = 0; k < count; k++){
+      const float *a = frames + (size_t)(k - 1) * pixels, *b = frames + (size_t)k * pixels;
+      double difference = 0;
+      if(first + k == 0) continue;
+      for(int i = 0; i < pixels; i++){
+        difference += fabs(a[i] - b[i]);
+      }
+      change[first + k] = difference / pixels;
+      if(change[first + k] > largest) largest = change[first + k];
+    }
+    memcpy(values, frames + (size_t)(count - 1) * pixels, sizeof(float) * pixels);
+    printf("power: %f, %d/%d samples\n", powers[first + count - 1], first + count, samples);
+  }
+
+  //Running totals, change[k] becomes the real change up to sample k and weighted[k] the one frames are spaced by
+  mean = 0;
+  for(int k = 1; k < samples; k++){
+    mean += change[k] / (samples - 1);
+  }
+  for(int k = 1; k < samples; k++){
+    weighted[k] = weighted[k - 1] + change[k] + SPACING_FLOOR * mean;
+    change[k] += change[k - 1];
+  }
+
+  fp = fopen(SPACING_PATH, "w");
+  if(fp == NULL){
+    printf("Could not write %s\n", SPACING_PATH);
+  }else{
+    fprintf(fp, "#start=%f end=%f divisions=%d\n#frame power time\n", START, END, DIVISIONS);
+    for(int f = 0, k = 0; f <= DIVISIONS; f++){
+      double target = weighted[samples - 1] * f / DIVISIONS;
+      double x, time;
+
+      while(k < samples - 2 && weighted[k + 1] < target) k++;
+      x = (weighted[k + 1] > weighted[k]) ? (target - weighted[k]) / (weighted[k + 1] - weighted[k]) : 0;
+      if(x > 1) x = 1;
+      time = (change[samples - 1] > 0) ? (change[k] + x * (change[k + 1] - change[k])) / change[samples - 1] : (double)f / DIVISIONS;
+      fprintf(fp, "%d %.9g %.9g\n", f, powers[k] + x * (powers[k + 1] - powers[k]), time);
+      if(f > 0 && time - previousTime > frameLargest) frameLargest = time - previousTime;
+      previousTime = time;
+    }
+    fclose(fp);
+    printf("Saved the spacing of %d frames to %s in %.1fs\n", DIVISIONS + 1, SPACING_PATH, Seconds() - start);
+    //Evenly spaced frames would change the most between the samples that change the most
+    if(frameLargest > 0 && change[samples - 1] > 0){
+      printf("Evenly spaced frames would need %.0f frames to never change more between two frames than these do\n", largest * (samples - 1) / (frameLargest * change[samples - 1]));
+    }
+  }
+
+  free(powers);
+  free(values);
+  free(histograms);
+  free(change);
+  free(weighted);
+}
+
+//Reads the powers in SPACING_PATH into spacedPowers. Returns 0 if it's missing or for another sweep.
+int LoadSpacing(){
+  char line[256];
+  float start, end;
+  int divisions, frame, count = 0;
+  float power;
+  FILE *fp = fopen(SPACING_PATH, "r");
+
+  if(fp == NULL) return 0;
+  if(fgets(line, sizeof(line), fp) == NULL || sscanf(line, "#start=%f end=%f divisions=%d", &start, &end, &divisions) != 3
+    || fabs(start - START) > 1e-4 || fabs(end - END) > 1e-4 || divisions != DIVISIONS){
+    fclose(fp);
+    return 0;
+  }
+  spacedPowers = malloc(sizeof(float) * (DIVISIONS + 1));
+  while(fgets(line, sizeof(line), fp) != NULL){
+    if(line[0] == '#') continue;
+    if(sscanf(line, "%d %f", &frame, &power) == 2 && frame == count && count <= DIVISIONS) spacedPowers[count++] = power;
+  }
+  fclose(fp);
+
+  if(count != DIVISIONS + 1){
+    free(spacedPowers);
+    spacedPowers = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+#define CERTIFICATES 4
+
+struct Certificate certificates[CERTIFICATES];
+pthread_mutex_t certificateLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t certificateDone = PTHREAD_COND_INITIALIZER;
+uint64_t certificateUses = 0;
+
+//Mandelbrot(), but pixels the frame's block has certified are copied instead of iterated.
+//Powers that aren't a frame of the sweep (tiles, previews) just go to Mandelbrot().
+void CertifiedMandelbrot(float *values, float *histogram, float power, float cR, float cI){
+  int frame = FrameIndex(power);
+  struct Certificate *certificate = (frame >= 0) ? CertificateGet(frame / CERTIFY_BLOCK, cR, cI) : NULL;
+
+  if(certificate == NULL){
+    Mandelbrot(values, histogram, power, cR, cI);
+    return;
+  }
+
+  for(int i = 0; i < WIDTH; i++){
+    if(JobCheckpoint()) break;
+    for(int j = 0; j < HEIGHT; j++){
+      int n = certificate->counts[i * HEIGHT + j];
+      if(n < 0) n = Escape(map(i, 0, WIDTH, MIN_X, MAX_X), map(j, 0, HEIGHT, MIN_Y, MAX_Y), power, cR, cI, MAX_I);
+
+      values[i * HEIGHT + j] = n;
+      if(n < MAX_I){
+        histogram[n]++;
+      }
+    }
+  }
+
+  pthread_mutex_lock(&certificateLock);
+  certificate->users--;
+  pthread_mutex_unlock(&certificateLock);
+}
+
+//Finds the block's certificate or starts a new one in the least recently used free place, then helps
+//finish it and waits for the other threads' columns. The caller has to take users back down by one.
+//NULL if every place is being used by other blocks.
+struct Certificate* CertificateGet(int block, float cR, float cI){
+  struct Certificate *certificate = NULL;
+  int i;
+  double start = Seconds();
+
+  pthread_mutex_lock(&certificateLock);
+  for(int k = 0; k < CERTIFICATES; k++){
+    if(certificates[k].counts != NULL && certificates[k].block == block && certificates[k].cR == cR && certificates[k].cI == cI){
+      certificate = &certificates[k];
+      break;
+    }
+    if(certificates[k].users == 0 && (certificate == NULL || certificates[k].lastUse < certificate->lastUse)) certificate = &certificates[k];
+  }
+  if(certificate == NULL){
+    pthread_mutex_unlock(&certificateLock);
+    return NULL;
+  }
+  if(certificate->counts == NULL || certificate->block != block || certificate->cR != cR || certificate->cI != cI){
+    if(certificate->counts == NULL) certificate->counts = malloc(sizeof(int16_t) * WIDTH * HEIGHT);
+    certificate->block = block;
+    certificate->cR = cR;
+    certificate->cI = cI;
+    atomic_store(&certificate->nextColumn, 0);
+    atomic_store(&certificate->doneColumns, 0);
+    atomic_store(&certificate->certified, 0);
+  }
+  certificate->users++;
+  certificate->lastUse = ++certificateUses;
+  pthread_mutex_unlock(&certificateLock);
+
+  while((i = atomic_fetch_add(&certificate->nextColumn, 1)) < WIDTH){
+    CertifyColumn(certificate, i);
+    if(atomic_fetch_add(&certificate->doneColumns, 1) == WIDTH - 1){
+      int first = block * CERTIFY_BLOCK;
+      int last = (first + CERTIFY_BLOCK - 1 < DIVISIONS) ? first + CERTIFY_BLOCK - 1 : DIVISIONS;
+      printf("certify: frames %d to %d, %.1f%% of the pixels certified, %.3fs\n", first, last, 100.0 * atomic_load(&certificate->certified) / (WIDTH * HEIGHT), Seconds() - start);
+      pthread_mutex_lock(&certificateLock);
+      pthread_cond_broadcast(&certificateDone);
+      pthread_mutex_unlock(&certificateLock);
+    }
+  }
+  pthread_mutex_lock(&certificateLock);
+  while(atomic_load(&certificate->doneColumns) < WIDTH){
+    pthread_cond_wait(&certificateDone, &certificateLock);
+  }
+  pthread_mutex_unlock(&certificateLock);
+  return certificate;
+}
+
+//Certifies column i over every power in the certificate's block
+void CertifyColumn(struct Certificate *certificate, int i){
+  float powerLo, powerHi;
+  int certified = 0;
+
+  BlockPowers(certificate->block, &powerLo, &powerHi);
+  for(int j = 0; j < HEIGHT; j++){
+    int n = MandelbrotCertify(map(i, 0, WIDTH, MIN_X, MAX_X), map(j, 0, HEIGHT, MIN_Y, MAX_Y), powerLo, powerHi, certificate->cR, certificate->cI, MAX_I);
+    certificate->counts[i * HEIGHT + j] = n;
+    if(n >= 0) certified++;
+  }
+  atomic_fetch_add(&certificate->certified, certified);
+}
+
+//Lowest and highest power of the block's frames
+void BlockPowers(int block, float *powerLo, float *powerHi){
+  int first = block * CERTIFY_BLOCK;
+  int last = (first + CERTIFY_BLOCK - 1 < DIVISIONS) ? first + CERTIFY_BLOCK - 1 : DIVISIONS;
+
+  *powerLo = *powerHi = FramePower(first);
+  for(int f = first + 1; f <= last; f++){
+    float power = FramePower(f);
+    if(power < *powerLo) *powerLo = power;
+    if(power > *powerHi) *powerHi = power;
+  }
+}
+
+//The frame of the sweep with this power, -1 if there isn't one
+int FrameIndex(float power){
+  int lo = 0, hi = DIVISIONS;
+
+  if(spacedPowers == NULL){
+    int frame = (int)round((power - START) / INCREMENT);
+    for(int f = frame - 1; f <= frame + 1; f++){
+      if(f >= 0 && f <= DIVISIONS && FramePower(f) == power) return f;
+    }
+    return -1;
+  }
+  while(lo < hi){
+    int mid = (lo + hi) / 2;
+    if(spacedPowers[mid] < power) lo = mid + 1;
+    else hi = mid;
+  }
+  return (spacedPowers[lo] == power) ? lo : -1;
+}
+
 //No, I couldn't think of a better way of doing it.
 //No, I don't want to talk about it.
 //Yes, I did use Python to write this.
@@ -0,0 +1,181 @@
+//Library version of the renderer, for calling it from other C or C++ programs.
+//Nothing in here touches globals, the caller owns every buffer, so it is safe to render
+//from as many threads at once as you want. The only files it opens are the ones the archive
+//and shared memory readers map (read only) for other programs to look at a sweep's output.
+
+#ifndef GENERALIZED_MANDELBROT_H
+#define GENERALIZED_MANDELBROT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//The window on the complex plane a frame covers, and how many pixels it is split into
+struct MandelbrotView{
+  float centerX, centerY;
+  float rangeX, rangeY;
+  int width, height;
+};
+
+//Number of iterations of z -> z^power + p + (cR + cI*i), starting at z = p = re + im*i,
+//before z escapes. Returns maxI if it never does.
+int MandelbrotEscape(float re, float im, float power, float cR, float cI, int maxI);
+
+//MandelbrotEscape() picking up where an earlier call with a smaller maxI stopped. orbitRe and orbitIm
+//are z after n iterations (re, im and 0 to start from scratch) and get updated to where z is now.
+//Returns the new count, so raising maxI only costs the extra iterations.
+int MandelbrotResume(float re, float im, float power, float cR, float cI, int maxI, float *orbitRe, float *orbitIm, int n);
+
+//MandelbrotResume() with z escaping once |z| gets to radius instead of 4. Every other function here uses 4.
+int MandelbrotResumeWithin(float re, float im, float power, float cR, float cI, int maxI, float *orbitRe, float *orbitIm, int n, float radius);
+
+//The power's own escape radius for MandelbrotResumeWithin(): max(|c|, 2^(1/(power-1))) for power > 1, c being
+//p + (cR + cI*i), past which z is sure to go to infinity. 4 for power <= 1. It is under 4 for powers over 1.5
+//(where |c| < 4), so escape counts come out lower there, and it grows without bound as the power gets close to 1.
+float MandelbrotBailout(float re, float im, float power, float cR, float cI);
+
+//The escape count MandelbrotEscape() gives for every power from powerLo to powerHi, or -1 if it can't prove
+//they all give the same one. Runs the iteration on intervals (the power, and a box around z that covers
+//every float z the real iteration could get to), widened enough to cover its float rounding.
+int MandelbrotCertify(float re, float im, float powerLo, float powerHi, float cR, float cI, int maxI);
+
+//Renders the escape count of every pixel of the view into values (width * height floats).
+//Frames are stored column by column like the JSON files, pixel (x, y) is values[x * height + y].
+//If histogram isn't NULL it gets maxI floats, histogram[n] being how many pixels escaped after n iterations.
+//Returns 0, or -1 if the arguments don't make sense.
+int MandelbrotRender(const struct MandelbrotView *view, float power, float cR, float cI, int maxI, float *values, float *histogram);
+
+//Renders one frame per power into values, frame k starting at values + k * width * height.
+//histograms (can be NULL) gets maxI floats per frame the same way. The frames are split
+//between threads worker threads (1 renders them all on the calling thread).
+//Returns 0, or -1 if the arguments don't make sense.
+int MandelbrotRenderBatch(const struct MandelbrotView *view, const float *powers, int count, float cR, float cI, int maxI, float *values, float *histograms, int threads);
+
+//Turns count escape counts into the colors the JSON files hold: a hue from 0 to 255,
+//or NaN for points in the set. histogram is the one MandelbrotRender() filled in.
+//Returns 0, or -1 if the arguments don't make sense.
+int MandelbrotColor(const float *values, int count, const float *histogram, int maxI, float *colors);
+
+//Archive files (ARCHIVE = 1 in the main program): a header, an index with one entry per frame, then
+//every frame's colors as raw floats, each starting on an ARCHIVE_ALIGN byte boundary. The colors are what
+//the JSON files hold (a hue from 0 to 255, NaN inside the set, see MandelbrotColor()), not escape counts.
+#define ARCHIVE_MAGIC 0x41424d47
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_ALIGN 64
+
+//Set in flags for a zoom animation (ZOOM = 1). Its frames are in the order of the animation instead of
+//increasing power, and several frames can share a power, so ArchiveFind() doesn't work on it.
+#define ARCHIVE_ZOOM 1
+
+struct ArchiveHeader{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t capacity;
+  uint32_t count;
+  uint32_t flags;
+  uint32_t unused;
+};
+
+struct ArchiveEntry{
+  float power;
+  uint32_t checksum;
+  uint64_t offset;
+  uint64_t length;
+};
+
+//Reader side, the whole file is memory mapped so frames are read in place
+struct ArchiveView{
+  void *base;
+  size_t size;
+  const struct ArchiveHeader *header;
+  const struct ArchiveEntry *index;
+};
+
+//Maps an archive for reading. Returns -1 if the file is missing or isn't an archive.
+int ArchiveMap(struct ArchiveView *view, const char *path);
+
+//Returns a pointer straight into the mapped file, no copy is made.
+//length is set to the number of floats in the frame. NULL if the frame isn't there (or isn't written yet).
+const float* ArchiveFrame(const struct ArchiveView *view, int frame, int *length);
+
+//Frames are stored in increasing power, so this is a binary search over the index.
+//Returns the frame closest to power, or -1 if the archive is empty or a zoom animation.
+int ArchiveFind(const struct ArchiveView *view, float power);
+
+//1 if the frame's data still matches the checksum in the index
+int ArchiveVerify(const struct ArchiveView *view, int frame);
+
+void ArchiveUnmap(struct ArchiveView *view);
+
+//The checksum the index holds for every frame (32 bit FNV-1a of its bytes)
+uint32_t ArchiveChecksum(const void *data, size_t length);
+
+#define SHM_MAGIC 0x52424d47
+#define SHM_VERSION 1
+
+//_Atomic isn't C++, there the fields are plain and only read through the functions below
+#ifdef __cplusplus
+#define MANDELBROT_ATOMIC(type) type
+#else
+#define MANDELBROT_ATOMIC(type) _Atomic type
+#endif
+
+//Frames published with SHM = 1 in the main program. The shared memory is this header, then slots ShmSlots,
+//then slots frames of width * height floats, each starting slotBytes after the one before (the first at
+//dataOffset). The n-th frame published (from 0) goes in slot n % slots. A reader waits for published to go past the last frame it read (it's a futex on Linux,
+//anywhere else poll it), then reads the slot. A slot's sequence is 2n + 1 while frame n is being written
+//into it and 2n + 2 once it's there, so a reader checks it before and after using the frame to know it
+//wasn't overwritten in between. done is set to 1 when the sweep is over.
+struct ShmHeader{
+  MANDELBROT_ATOMIC(uint32_t) magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t slots;
+  uint32_t raw;
+  uint64_t slotBytes;
+  uint64_t dataOffset;
+  MANDELBROT_ATOMIC(uint32_t) published;
+  MANDELBROT_ATOMIC(uint32_t) done;
+};
+
+struct ShmSlot{
+  MANDELBROT_ATOMIC(uint32_t) sequence;
+  //Frame number in the sweep and its power
+  int32_t frame;
+  float power;
+  uint32_t unused;
+};
+
+//A reader's mapping, next is the published count it has read up to
+struct ShmView{
+  struct ShmHeader *header;
+  struct ShmSlot *slots;
+  size_t size;
+  uint32_t next;
+};
+
+//For viewers, maps the frames a sweep is publishing under name (SHM_NAME in the main program).
+//Returns -1 if there is no sweep publishing them.
+int ShmMap(struct ShmView *view, const char *name);
+
+//Waits for the next frame and returns it straight out of the shared memory, or NULL once the sweep is done.
+//If the reader fell more than a ring behind it skips ahead to the oldest frame still there.
+//Pass index to ShmValid() after using the frame to check it wasn't overwritten meanwhile.
+const float* ShmNext(struct ShmView *view, int *frame, float *power, uint32_t *index);
+
+//1 if the index-th published frame is still in its slot
+int ShmValid(const struct ShmView *view, uint32_t index);
+
+void ShmUnmap(struct ShmView *view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
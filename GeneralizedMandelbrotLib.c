@@ -0,0 +1,411 @@
+//The reentrant core of the renderer, see GeneralizedMandelbrot.h.
+//The main program uses MandelbrotEscape() from here too, so both always run the same kernel.
+
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <stdatomic.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "GeneralizedMandelbrot.h"
+
+int MandelbrotEscape(float re, float im, float power, float cR, float cI, int maxI){
+  float zRe = re, zIm = im;
+  return MandelbrotResume(re, im, power, cR, cI, maxI, &zRe, &zIm, 0);
+}
+
+int MandelbrotResume(float re, float im, float power, float cR, float cI, int maxI, float *orbitRe, float *orbitIm, int n){
+  return MandelbrotResumeWithin(re, im, power, cR, cI, maxI, orbitRe, orbitIm, n, 4);
+}
+
+float MandelbrotBailout(float re, float im, float power, float cR, float cI){
+  double c, radius;
+
+  if(power <= 1) return 4;
+  //Past max(|c|, 2^(1/(power-1))), |z^power + c| >= |z|^power - |c| > |z| (|z|^(power-1) - 1) > |z|, so z keeps growing
+  c = sqrt((double)(re + cR) * (re + cR) + (double)(im + cI) * (im + cI));
+  radius = pow(2.0, 1.0 / (power - 1.0));
+  return (float)((c > radius) ? c : radius);
+}
+
+int MandelbrotResumeWithin(float re, float im, float power, float cR, float cI, int maxI, float *orbitRe, float *orbitIm, int n, float radius){
+  float zRe = *orbitRe, zIm = *orbitIm;
+  float radius2 = radius * radius;
+
+  //If the modulus of the complex number (the distance between it and the origin) is
+  //greater than the radius (4 unless asked otherwise), break b/c it will go to infinity. If the point has reached n,
+  //it is considered 'in'. Compared squared (|z|^2 < radius^2), which gives exactly the same answer without the sqrt.
+  while(n < maxI && zRe * zRe + zIm * zIm < radius2){
+    //z^power in polar form, 0 stays 0
+    if(zRe != 0.0 || zIm != 0){
+      float r = pow(zRe * zRe + zIm * zIm, power / 2.0);
+      float theta = power * atan2(zIm, zRe);
+      zRe = r * cos(theta) + re + cR;
+      zIm = r * sin(theta) + im + cI;
+    }
+    n++;
+  }
+  *orbitRe = zRe;
+  *orbitIm = zIm;
+  return n;
+}
+
+//A range of numbers for MandelbrotCertify(), lo to hi
+struct Interval{
+  double lo, hi;
+};
+
+//Widens an interval enough to cover a float rounding (4 ulps) of anything in it, plus slack for the double
+//rounding of a sum whose terms were up to scale big
+static struct Interval Widen(struct Interval x, double scale){
+  double ulps = 1.0 / (1 << 21);
+  x.lo -= fabs(x.lo) * ulps + scale * 1e-13 + 1e-30;
+  x.hi += fabs(x.hi) * ulps + scale * 1e-13 + 1e-30;
+  return x;
+}
+
+static struct Interval Square(struct Interval x){
+  struct Interval y;
+  double a = x.lo * x.lo, b = x.hi * x.hi;
+  y.lo = (x.lo <= 0 && x.hi >= 0) ? 0 : fmin(a, b);
+  y.hi = fmax(a, b);
+  return y;
+}
+
+static struct Interval Multiply(struct Interval x, struct Interval y){
+  double a = x.lo * y.lo, b = x.lo * y.hi, c = x.hi * y.lo, d = x.hi * y.hi;
+  struct Interval z = {fmin(fmin(a, b), fmin(c, d)), fmax(fmax(a, b), fmax(c, d))};
+  return z;
+}
+
+//cos over an interval, the ends plus 1 or -1 if a peak or a trough is in between
+static struct Interval Cosine(struct Interval x){
+  struct Interval y = {-1, 1};
+  double a, b;
+
+  if(x.hi - x.lo >= 2 * M_PI) return y;
+  a = cos(x.lo);
+  b = cos(x.hi);
+  y.lo = fmin(a, b);
+  y.hi = fmax(a, b);
+  if(2 * M_PI * ceil(x.lo / (2 * M_PI)) <= x.hi) y.hi = 1;
+  if(M_PI + 2 * M_PI * ceil((x.lo - M_PI) / (2 * M_PI)) <= x.hi) y.lo = -1;
+  return y;
+}
+
+int MandelbrotCertify(float re, float im, float powerLo, float powerHi, float cR, float cI, int maxI){
+  struct Interval zRe = {re, re}, zIm = {im, im};
+  struct Interval half = {powerLo / 2.0, powerHi / 2.0}, power = {powerLo, powerHi};
+  double addRe = (double)re + cR, addIm = (double)im + cI;
+
+  for(int n = 0; n < maxI; n++){
+    struct Interval x2 = Square(zRe), y2 = Square(zIm);
+    struct Interval r2 = {x2.lo + y2.lo, x2.hi + y2.hi};
+    struct Interval r, angle, theta, c, s;
+    double corners[4];
+
+    //The loop test, either every power has escaped by now or none has
+    r2 = Widen(r2, 0);
+    if(r2.lo >= 16) return n;
+    if(r2.hi >= 16) return -1;
+
+    //z = 0 isn't iterated, and atan2 jumps across the negative real axis, so boxes touching either can't be done
+    if(zRe.lo <= 0 && zIm.lo <= 0 && zIm.hi >= 0) return -1;
+    if(r2.lo <= 0) return -1;
+
+    //pow and atan2 are monotonic along each side of the box, so the corners give their range
+    corners[0] = pow(r2.lo, half.lo);
+    corners[1] = pow(r2.lo, half.hi);
+    corners[2] = pow(r2.hi, half.lo);
+    corners[3] = pow(r2.hi, half.hi);
+    r.lo = fmin(fmin(corners[0], corners[1]), fmin(corners[2], corners[3]));
+    r.hi = fmax(fmax(corners[0], corners[1]), fmax(corners[2], corners[3]));
+    r = Widen(r, 0);
+    corners[0] = atan2(zIm.lo, zRe.lo);
+    corners[1] = atan2(zIm.lo, zRe.hi);
+    corners[2] = atan2(zIm.hi, zRe.lo);
+    corners[3] = atan2(zIm.hi, zRe.hi);
+    angle.lo = fmin(fmin(corners[0], corners[1]), fmin(corners[2], corners[3]));
+    angle.hi = fmax(fmax(corners[0], corners[1]), fmax(corners[2], corners[3]));
+    theta = Widen(Multiply(power, angle), 0);
+
+    c = Cosine(theta);
+    theta.lo -= M_PI / 2;
+    theta.hi -= M_PI / 2;
+    s = Cosine(theta);
+    zRe = Multiply(r, c);
+    zRe.lo += addRe;
+    zRe.hi += addRe;
+    zRe = Widen(zRe, r.hi + fabs(addRe));
+    zIm = Multiply(r, s);
+    zIm.lo += addIm;
+    zIm.hi += addIm;
+    zIm = Widen(zIm, r.hi + fabs(addIm));
+  }
+  return maxI;
+}
+
+int MandelbrotRender(const struct MandelbrotView *view, float power, float cR, float cI, int maxI, float *values, float *histogram){
+  float minX, minY;
+
+  if(view == NULL || values == NULL || view->width < 1 || view->height < 1 || maxI < 1) return -1;
+  minX = view->centerX - view->rangeX / 2.0;
+  minY = view->centerY - view->rangeY / 2.0;
+
+  if(histogram != NULL){
+    for(int i = 0; i < maxI; i++){
+      histogram[i] = 0;
+    }
+  }
+
+  for(int i = 0; i < view->width; i++){
+    for(int j = 0; j < view->height; j++){
+      float re = minX + (i * view->rangeX) / view->width;
+      float im = minY + (j * view->rangeY) / view->height;
+      int n = MandelbrotEscape(re, im, power, cR, cI, maxI);
+
+      values[i * view->height + j] = n;
+      if(histogram != NULL && n < maxI) histogram[n]++;
+    }
+  }
+  return 0;
+}
+
+//One worker's share of MandelbrotRenderBatch(), it takes every threads-th frame
+struct BatchWork{
+  const struct MandelbrotView *view;
+  const float *powers;
+  int count;
+  float cR, cI;
+  int maxI;
+  float *values;
+  float *histograms;
+  int first, threads;
+};
+
+static void* BatchWorker(void *arg){
+  struct BatchWork *work = arg;
+  size_t pixels = (size_t)work->view->width * work->view->height;
+
+  for(int k = work->first; k < work->count; k += work->threads){
+    float *histogram = (work->histograms != NULL) ? work->histograms + (size_t)k * work->maxI : NULL;
+    MandelbrotRender(work->view, work->powers[k], work->cR, work->cI, work->maxI, work->values + k * pixels, histogram);
+  }
+  return NULL;
+}
+
+int MandelbrotRenderBatch(const struct MandelbrotView *view, const float *powers, int count, float cR, float cI, int maxI, float *values, float *histograms, int threads){
+  struct BatchWork *work;
+  pthread_t *handles;
+  int started = 0;
+
+  if(view == NULL || powers == NULL || values == NULL || count < 0 || view->width < 1 || view->height < 1 || maxI < 1) return -1;
+  if(threads > count) threads = count;
+  if(threads < 1) threads = 1;
+
+  work = malloc(sizeof(struct BatchWork) * threads);
+  handles = malloc(sizeof(pthread_t) * threads);
+  if(work == NULL || handles == NULL){
+    free(work);
+    free(handles);
+    return -1;
+  }
+
+  for(int t = 0; t < threads; t++){
+    struct BatchWork w = {view, powers, count, cR, cI, maxI, values, histograms, t, threads};
+    work[t] = w;
+  }
+  //Worker 0 runs on the calling thread. If a thread can't be started, its frames go to the calling thread too.
+  for(int t = 1; t < threads; t++){
+    if(pthread_create(&handles[t], NULL, BatchWorker, &work[t]) != 0) break;
+    started++;
+  }
+  for(int t = started + 1; t < threads; t++){
+    BatchWorker(&work[t]);
+  }
+  BatchWorker(&work[0]);
+  for(int t = 1; t <= started; t++){
+    pthread_join(handles[t], NULL);
+  }
+
+  free(work);
+  free(handles);
+  return 0;
+}
+
+//Same colors as CalculateColors() in GeneralizedMandelbrot.c
+int MandelbrotColor(const float *values, int count, const float *histogram, int maxI, float *colors){
+  float *hues;
+  float total = 0, h = 0;
+
+  if(values == NULL || histogram == NULL || colors == NULL || count < 0 || maxI < 1) return -1;
+  hues = malloc(sizeof(float) * maxI);
+  if(hues == NULL) return -1;
+
+  for(int i = 0; i < maxI; i++){
+    total += (int)histogram[i];
+  }
+  for(int i = 0; i < maxI; i++){
+    h += histogram[i] / total;
+    hues[i] = h;
+  }
+  hues[maxI - 1] = h;
+
+  for(int i = 0; i < count; i++){
+    float currentVal = values[i];
+    if((int)currentVal >= maxI){
+      colors[i] = NAN;
+    }else{
+      int upper = ((int)ceil(currentVal) < maxI) ? (int)ceil(currentVal) : maxI - 1;
+      float point = currentVal - (int)currentVal;
+      colors[i] = 255 - 255 * (hues[(int)currentVal] * (1 - point) + hues[upper] * point);
+    }
+  }
+
+  free(hues);
+  return 0;
+}
+
+int ArchiveMap(struct ArchiveView *view, const char *path){
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+
+  if(fd < 0) return -1;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct ArchiveHeader)){
+    close(fd);
+    return -1;
+  }
+
+  view->size = st.st_size;
+  view->base = mmap(NULL, view->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(view->base == MAP_FAILED) return -1;
+
+  view->header = view->base;
+  view->index = (const struct ArchiveEntry*)((const char*)view->base + sizeof(struct ArchiveHeader));
+  if(view->header->magic != ARCHIVE_MAGIC || view->header->version != ARCHIVE_VERSION || view->header->count > view->header->capacity
+     || sizeof(struct ArchiveHeader) + (uint64_t)view->header->capacity * sizeof(struct ArchiveEntry) > view->size){
+    ArchiveUnmap(view);
+    return -1;
+  }
+  return 0;
+}
+
+const float* ArchiveFrame(const struct ArchiveView *view, int frame, int *length){
+  const struct ArchiveEntry *entry;
+
+  if(frame < 0 || (uint32_t)frame >= view->header->count) return NULL;
+  entry = &view->index[frame];
+  if(entry->length == 0 || entry->offset + entry->length > view->size) return NULL;
+
+  if(length != NULL) *length = entry->length / sizeof(float);
+  return (const float*)((const char*)view->base + entry->offset);
+}
+
+int ArchiveFind(const struct ArchiveView *view, float power){
+  int lo = 0, hi = (int)view->header->count - 1;
+
+  if(hi < 0 || (view->header->flags & ARCHIVE_ZOOM)) return -1;
+  while(lo < hi){
+    int mid = (lo + hi) / 2;
+    if(view->index[mid].power < power){
+      lo = mid + 1;
+    }else{
+      hi = mid;
+    }
+  }
+  if(lo > 0 && fabs(view->index[lo - 1].power - power) <= fabs(view->index[lo].power - power)) lo--;
+  return lo;
+}
+
+int ArchiveVerify(const struct ArchiveView *view, int frame){
+  int length;
+  const float *arr = ArchiveFrame(view, frame, &length);
+
+  if(arr == NULL) return 0;
+  return ArchiveChecksum(arr, (size_t)length * sizeof(float)) == view->index[frame].checksum;
+}
+
+void ArchiveUnmap(struct ArchiveView *view){
+  munmap(view->base, view->size);
+  view->base = NULL;
+  view->header = NULL;
+  view->index = NULL;
+}
+
+uint32_t ArchiveChecksum(const void *data, size_t length){
+  const unsigned char *bytes = data;
+  uint32_t hash = 2166136261u;
+  for(size_t i = 0; i < length; i++){
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+int ShmMap(struct ShmView *view, const char *name){
+  struct stat st;
+  int fd = shm_open(name, O_RDONLY, 0);
+
+  if(fd < 0) return -1;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct ShmHeader)){
+    close(fd);
+    return -1;
+  }
+  view->size = st.st_size;
+  view->header = mmap(NULL, view->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(view->header == MAP_FAILED) return -1;
+
+  if(atomic_load(&view->header->magic) != SHM_MAGIC || view->header->version != SHM_VERSION){
+    ShmUnmap(view);
+    return -1;
+  }
+  view->slots = (struct ShmSlot*)(view->header + 1);
+  view->next = 0;
+  return 0;
+}
+
+const float* ShmNext(struct ShmView *view, int *frame, float *power, uint32_t *index){
+  struct ShmHeader *header = view->header;
+
+  while(1){
+    uint32_t published = atomic_load(&header->published);
+
+    if(published == view->next){
+      if(atomic_load(&header->done)) return NULL;
+#ifdef __linux__
+      struct timespec timeout = {0, 100000000};
+      syscall(SYS_futex, &header->published, FUTEX_WAIT, published, &timeout, NULL, 0);
+#else
+      usleep(1000);
+#endif
+      continue;
+    }
+    if(published - view->next > header->slots) view->next = published - header->slots;
+
+    *index = view->next++;
+    if(!ShmValid(view, *index)) continue;
+    *frame = view->slots[*index % header->slots].frame;
+    *power = view->slots[*index % header->slots].power;
+    if(!ShmValid(view, *index)) continue;
+    return (const float*)((const char*)header + header->dataOffset + (*index % header->slots) * header->slotBytes);
+  }
+}
+
+int ShmValid(const struct ShmView *view, uint32_t index){
+  return atomic_load(&view->slots[index % view->header->slots].sequence) == 2 * index + 2;
+}
+
+void ShmUnmap(struct ShmView *view){
+  munmap(view->header, view->size);
+  view->header = NULL;
+  view->slots = NULL;
+}
@@ -0,0 +1,233 @@
+#Python bindings for the renderer library (run make first to build libgeneralizedmandelbrot.so, .dylib on macOS).
+#Frames get rendered straight into whatever buffer you pass in (a NumPy array, array.array,
+#bytearray, anything writable with the buffer protocol), so nothing is copied and there is no
+#JSON to parse. ctypes lets go of the GIL while the C code runs, so other Python threads keep going.
+#
+#   import numpy as np
+#   import generalizedmandelbrot as gm
+#   values, histogram = gm.render(2.5, out=np.empty((900, 900), np.float32))
+#   frames, histograms = gm.sweep(np.linspace(-10, 10, 1000, dtype=np.float32), width=300, height=300)
+
+import ctypes
+import mmap
+import os
+import struct
+import sys
+import time
+from array import array
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+_name = "libgeneralizedmandelbrot.dylib" if sys.platform == "darwin" else "libgeneralizedmandelbrot.so"
+_lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), _name))
+
+
+class View(ctypes.Structure):
+    _fields_ = [("centerX", ctypes.c_float), ("centerY", ctypes.c_float),
+                ("rangeX", ctypes.c_float), ("rangeY", ctypes.c_float),
+                ("width", ctypes.c_int), ("height", ctypes.c_int)]
+
+
+class _ArchiveHeader(ctypes.Structure):
+    _fields_ = [("magic", ctypes.c_uint32), ("version", ctypes.c_uint32), ("width", ctypes.c_uint32),
+                ("height", ctypes.c_uint32), ("capacity", ctypes.c_uint32), ("count", ctypes.c_uint32),
+                ("flags", ctypes.c_uint32), ("unused", ctypes.c_uint32)]
+
+
+class _ArchiveEntry(ctypes.Structure):
+    _fields_ = [("power", ctypes.c_float), ("checksum", ctypes.c_uint32),
+                ("offset", ctypes.c_uint64), ("length", ctypes.c_uint64)]
+
+
+class _ArchiveView(ctypes.Structure):
+    _fields_ = [("base", ctypes.c_void_p), ("size", ctypes.c_size_t),
+                ("header", ctypes.POINTER(_ArchiveHeader)), ("index", ctypes.POINTER(_ArchiveEntry))]
+
+
+_floats = ctypes.POINTER(ctypes.c_float)
+_lib.MandelbrotRender.argtypes = [ctypes.POINTER(View), ctypes.c_float, ctypes.c_float, ctypes.c_float, ctypes.c_int, _floats, _floats]
+_lib.MandelbrotRender.restype = ctypes.c_int
+_lib.MandelbrotRenderBatch.argtypes = [ctypes.POINTER(View), _floats, ctypes.c_int, ctypes.c_float, ctypes.c_float, ctypes.c_int, _floats, _floats, ctypes.c_int]
+_lib.MandelbrotRenderBatch.restype = ctypes.c_int
+_lib.MandelbrotColor.argtypes = [_floats, ctypes.c_int, _floats, ctypes.c_int, _floats]
+_lib.MandelbrotColor.restype = ctypes.c_int
+_lib.ArchiveMap.argtypes = [ctypes.POINTER(_ArchiveView), ctypes.c_char_p]
+_lib.ArchiveMap.restype = ctypes.c_int
+_lib.ArchiveFrame.argtypes = [ctypes.POINTER(_ArchiveView), ctypes.c_int, ctypes.POINTER(ctypes.c_int)]
+_lib.ArchiveFrame.restype = _floats
+_lib.ArchiveFind.argtypes = [ctypes.POINTER(_ArchiveView), ctypes.c_float]
+_lib.ArchiveFind.restype = ctypes.c_int
+_lib.ArchiveVerify.argtypes = [ctypes.POINTER(_ArchiveView), ctypes.c_int]
+_lib.ArchiveVerify.restype = ctypes.c_int
+_lib.ArchiveUnmap.argtypes = [ctypes.POINTER(_ArchiveView)]
+_lib.ArchiveUnmap.restype = None
+
+
+def _empty(count, shape):
+    if numpy is not None:
+        return numpy.empty(shape, numpy.float32)
+    return array("f", bytes(4 * count))
+
+
+#Pointer to the buffer's memory, checks it is writable float32 data with room for count floats
+def _pointer(buffer, count, name):
+    view = memoryview(buffer)
+    if view.readonly or view.format != "f" or not view.c_contiguous:
+        raise ValueError(name + " has to be a writable, contiguous float32 buffer")
+    if view.nbytes < 4 * count:
+        raise ValueError(name + " needs room for %d floats" % count)
+    return ctypes.cast((ctypes.c_float * count).from_buffer(buffer), _floats)
+
+
+#Read only buffers (like the frames sweep() returns) still work for inputs
+def _input(buffer, count, name):
+    view = memoryview(buffer)
+    if view.format != "f" or not view.c_contiguous or view.nbytes < 4 * count:
+        raise ValueError(name + " has to be a contiguous float32 buffer with %d floats" % count)
+    if view.readonly:
+        return _pointer(bytearray(view.cast("B")), count, name)
+    return _pointer(buffer, count, name)
+
+
+def _view(width, height, center, range_):
+    return View(center[0], center[1], range_[0], range_[1], width, height)
+
+
+#Escape counts for one frame. out is width * height floats (shape (width, height) for NumPy,
+#same layout as the JSON frames), histogram is max_i floats. Both get allocated if left out.
+def render(power, width=900, height=900, center=(0, 0), range_=(3.5, 3.5), max_i=80, c=(0, 0), out=None, histogram=None):
+    pixels = width * height
+    if out is None:
+        out = _empty(pixels, (width, height))
+    if histogram is None:
+        histogram = _empty(max_i, (max_i,))
+
+    if _lib.MandelbrotRender(ctypes.byref(_view(width, height, center, range_)), power, c[0], c[1], max_i,
+                             _pointer(out, pixels, "out"), _pointer(histogram, max_i, "histogram")) != 0:
+        raise ValueError("bad view or max_i")
+    return out, histogram
+
+
+#One frame per power, rendered on threads C threads. out is len(powers) * width * height floats
+#(shape (frames, width, height) for NumPy), histograms is len(powers) * max_i floats.
+def sweep(powers, width=900, height=900, center=(0, 0), range_=(3.5, 3.5), max_i=80, c=(0, 0), out=None, histograms=None, threads=None):
+    if not isinstance(powers, (array, memoryview)) and not (numpy is not None and isinstance(powers, numpy.ndarray)):
+        powers = array("f", powers)
+    if numpy is not None and isinstance(powers, numpy.ndarray) and (powers.dtype != numpy.float32 or not powers.flags.c_contiguous):
+        powers = numpy.ascontiguousarray(powers, numpy.float32)
+    count = len(powers)
+    pixels = width * height
+    if out is None:
+        out = _empty(count * pixels, (count, width, height))
+    if histograms is None:
+        histograms = _empty(count * max_i, (count, max_i))
+    if threads is None:
+        threads = os.cpu_count() or 1
+
+    if _lib.MandelbrotRenderBatch(ctypes.byref(_view(width, height, center, range_)), _input(powers, count, "powers"), count,
+                                  c[0], c[1], max_i, _pointer(out, count * pixels, "out"),
+                                  _pointer(histograms, count * max_i, "histograms"), threads) != 0:
+        raise ValueError("bad view or max_i")
+    return out, histograms
+
+
+#Hues (0 to 255, NaN inside the set) for escape counts from render(), like the JSON files hold
+def colors(values, histogram, max_i=80, out=None):
+    count = memoryview(values).nbytes // 4
+    if out is None:
+        out = _empty(count, memoryview(values).shape if numpy is None else numpy.shape(values))
+    if _lib.MandelbrotColor(_input(values, count, "values"), count, _input(histogram, max_i, "histogram"), max_i,
+                            _pointer(out, count, "out")) != 0:
+        raise ValueError("bad max_i")
+    return out
+
+
+#An archive a sweep wrote with ARCHIVE = 1, mapped read only. frame(k) copies frame k's colors out (hues
+#from 0 to 255, NaN inside the set, like the JSON files and colors() give; shape (width, height) for NumPy), find(power) is the frame closest to power and powers() lists them all.
+#A zoom animation's archive has zoom set, its frames are in animation order so find() doesn't work on it.
+#
+#   with gm.archive("mandelbrot.archive") as a:
+#       hues = a.frame(a.find(2.5))
+class archive:
+    def __init__(self, path):
+        self._view = _ArchiveView()
+        if _lib.ArchiveMap(ctypes.byref(self._view), os.fsencode(path)) != 0:
+            raise ValueError(str(path) + " is missing or isn't an archive")
+        header = self._view.header.contents
+        self.width, self.height = header.width, header.height
+        self.zoom = bool(header.flags & 1)
+
+    def __len__(self):
+        return self._view.header.contents.count
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def close(self):
+        if self._view.base:
+            _lib.ArchiveUnmap(ctypes.byref(self._view))
+
+    def powers(self):
+        return [self._view.index[k].power for k in range(len(self))]
+
+    def find(self, power):
+        frame = _lib.ArchiveFind(ctypes.byref(self._view), power)
+        if frame < 0:
+            raise ValueError("the archive is empty or a zoom animation")
+        return frame
+
+    #verify checks the frame against the checksum in the index first
+    def frame(self, frame, out=None, verify=False):
+        length = ctypes.c_int()
+        data = _lib.ArchiveFrame(ctypes.byref(self._view), frame, ctypes.byref(length))
+        if not data:
+            raise IndexError("frame %d isn't in the archive (or isn't written yet)" % frame)
+        if verify and not _lib.ArchiveVerify(ctypes.byref(self._view), frame):
+            raise ValueError("frame %d doesn't match its checksum" % frame)
+        if out is None:
+            out = _empty(length.value, (self.width, self.height))
+        ctypes.memmove(_pointer(out, length.value, "out"), data, 4 * length.value)
+        return out
+
+
+#Frames a sweep run with SHM = 1 is publishing, as (frame, power, values) while it runs (Linux only, the
+#shared memory is a file in /dev/shm there). values is the frame's width * height floats copied out of the
+#shared memory (shape (width, height) for NumPy). Frames the reader fell too far behind on, or that got
+#overwritten while being copied, get skipped. Stops when the sweep is done.
+def frames(name="/mandelbrot_frames", poll=0.001):
+    with open("/dev/shm" + name, "rb") as f:
+        memory = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, width, height, slots, raw, slot_bytes, data_offset = struct.unpack_from("<6I2Q", memory, 0)
+    if magic != 0x52424d47 or version != 1:
+        raise ValueError(name + " isn't frames from the renderer")
+    pixels = width * height
+    next_ = 0
+
+    while True:
+        published, done = struct.unpack_from("<2I", memory, 40)
+        if published == next_:
+            if done:
+                return
+            time.sleep(poll)
+            continue
+        next_ = max(next_, published - slots)
+        index = next_
+        next_ += 1
+        slot = 48 + 16 * (index % slots)
+        sequence, frame, power = struct.unpack_from("<Iif", memory, slot)
+        if sequence != 2 * index + 2:
+            continue
+        start = data_offset + (index % slots) * slot_bytes
+        values = _empty(pixels, (width, height))
+        with memoryview(values) as out, memoryview(memory) as source:
+            out.cast("B")[:] = source[start:start + 4 * pixels]
+        #The writer may have started on the slot again while it was copied
+        if struct.unpack_from("<I", memory, slot)[0] != 2 * index + 2:
+            continue
+        yield frame, power, values